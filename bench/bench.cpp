@@ -0,0 +1,820 @@
+/*
+
+ArduinoAsyncTasks - Host Benchmark
+
+Runs the library on the host backend (Linux / pthreads) and reports:
+- task spawn latency, from `run()` to the start of the task function, also for
+  tasks created on the preallocated stacks of a `StackPool`
+- jobs per second, for new FreeRTOS tasks, `TaskPool` and `WorkStealingExecutor`
+- scheduler tick cost versus the number of scheduled tasks
+- firing jitter percentiles and drift of a periodic task
+- cron next-firing computation, over every firing of a year
+- firings per second of a single `Scheduler` versus a `ShardedScheduler`,
+  with more inline work than one core can keep up with
+- wakeups of the scheduler task with and without timer slack
+- `AsyncTask` runs with a 4 KB argument, and how often it's copied and moved
+- items per second through a `Channel` versus a FreeRTOS queue, between two tasks
+- a FIR filter over sample blocks: serial, split over two `AsyncTask`s joined with
+  a semaphore, and with `parallelFor()`
+- the energy of a sample block, serial and with `parallelReduce()`
+- frame dispatch cost of a `StaticSchedule`, and its firings on its own task, checked:
+  every job fires once per period (±1, for the firings at both ends of the run), the
+  frames that started a whole frame late (overruns) are only reported
+- `StackProfile` recording and lookup cost, and the size of its exported source
+
+The numbers are for comparing changes of the library on the same machine,
+not a prediction of the timings on a board. A failed check is printed with FAIL,
+and the bench exits with 1.
+
+    ./async_tasks_bench          full run
+    ./async_tasks_bench --quick  fewer samples, for CI
+
+*/
+
+#include <ArduinoAsyncTasks.h>
+#include <Scheduler.h>
+#include <ShardedScheduler.h>
+#include <stack_pool.h>
+#include <stack_profile.h>
+#include <static_schedule.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <Parallel.h>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static bool quick = false;
+// checks that failed, the exit code is 1 if there are any
+static int failures = 0;
+
+static uint64_t nowNs(){
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now().time_since_epoch()
+    ).count();
+}
+
+// Percentiles of a set of samples
+class Samples{
+    std::vector<uint64_t> _values;
+    bool _sorted = false;
+
+  public:
+    void reserve(size_t count){
+        _values.reserve(count);
+    }
+
+    void add(uint64_t value){
+        _values.push_back(value);
+        _sorted = false;
+    }
+
+    uint64_t percentile(double p){
+        if (_values.empty()){
+            return 0;
+        }
+        if (!_sorted){
+            std::sort(_values.begin(), _values.end());
+            _sorted = true;
+        }
+        size_t index = size_t(p / 100.0 * double(_values.size() - 1) + 0.5);
+        return _values[std::min(index, _values.size() - 1)];
+    }
+
+    uint64_t mean() const{
+        uint64_t sum = 0;
+        for (uint64_t v : _values){
+            sum += v;
+        }
+        return _values.empty() ? 0 : sum / _values.size();
+    }
+};
+
+static void printHeader(const char* title){
+    printf("\n== %s ==\n", title);
+}
+
+// ---- Spawn latency ----
+
+static std::atomic<uint64_t> startedAt(0);
+static std::atomic<uint32_t> finished(0);
+
+static void spawnLatency(const char* name, const TaskParams& params){
+    const int runs = quick ? 200 : 2000;
+    Samples samples;
+    samples.reserve(runs);
+
+    for (int i = 0; i < runs; i++){
+        finished = 0;
+        uint64_t submitted = nowNs();
+        AsyncTask<> task(params, [](){
+            startedAt = nowNs();
+            finished = 1;
+        });
+        task.run();
+        while (finished.load() == 0){
+            taskYIELD();
+        }
+        samples.add(startedAt.load() - submitted);
+    }
+
+    printf("%-24s p50 %7.1f us  p99 %7.1f us  max %7.1f us\n", name,
+        samples.percentile(50) / 1000.0, samples.percentile(99) / 1000.0, samples.percentile(100) / 1000.0);
+}
+
+// stacks of the `StackPool` spawn latency, the host port needs 64 KB for a thread
+// and allocates smaller stacks itself
+static StackPool<65536, 4> benchStacks;
+
+// ---- Throughput ----
+
+static std::atomic<uint32_t> completed(0);
+
+static void countJob(void*){
+    completed++;
+}
+
+// Raw executor throughput, `submit()` retried while the executor is full
+static void executorThroughput(const char* name, Executor& executor){
+    const uint32_t jobs = quick ? 20000 : 200000;
+    completed = 0;
+
+    uint64_t start = nowNs();
+    for (uint32_t i = 0; i < jobs; i++){
+        while (!executor.submit(countJob, nullptr)){
+            taskYIELD();
+        }
+    }
+    while (completed.load() < jobs){
+        taskYIELD();
+    }
+    double seconds = (nowNs() - start) / 1e9;
+
+    printf("%-34s %10.0f jobs/s\n", name, jobs / seconds);
+}
+
+// `AsyncTask::run()` throughput, with at most `inFlight` tasks waiting at once,
+// so a full executor doesn't fall back to new FreeRTOS tasks
+static void asyncTaskThroughput(const char* name, Executor* executor, uint32_t jobs, uint32_t inFlight){
+    completed = 0;
+
+    uint64_t start = nowNs();
+    for (uint32_t i = 0; i < jobs; i++){
+        while (i - completed.load() >= inFlight){
+            taskYIELD();
+        }
+        AsyncTask<> task(TaskParams().setExecutor(executor), [](){
+            completed++;
+        });
+        task.run();
+    }
+    while (completed.load() < jobs){
+        taskYIELD();
+    }
+    double seconds = (nowNs() - start) / 1e9;
+
+    printf("%-34s %10.0f jobs/s\n", name, jobs / seconds);
+}
+
+// ---- Scheduler tick cost ----
+
+static std::atomic<uint32_t> firings(0);
+
+static void tickCost(uint32_t count){
+    Scheduler scheduler;
+
+    // intervals from 1 to 60 seconds, a tick has only a few due tasks
+    for (uint32_t i = 0; i < count; i++){
+        scheduler.addTask([](){ firings++; },
+            ScheduleParams(1 + i % 60, TimeUnit::Seconds, ExecutionPolicy::Inline));
+    }
+    // the first tick runs every task once
+    uint64_t start = nowNs();
+    scheduler.execute();
+    uint64_t allDue = nowNs() - start;
+
+    Samples samples;
+    const uint64_t duration = quick ? 200000000ull : 1000000000ull;
+    uint64_t begin = nowNs();
+    while (nowNs() - begin < duration){
+        uint64_t t = nowNs();
+        scheduler.execute();
+        samples.add(nowNs() - t);
+        delay(1);
+    }
+
+    printf("%6lu tasks  tick p50 %8.2f us  p99 %8.2f us  all due %9.1f us (%5.0f ns/task)\n",
+        (unsigned long)count, samples.percentile(50) / 1000.0, samples.percentile(99) / 1000.0,
+        allDue / 1000.0, double(allDue) / count);
+}
+
+// ---- Firing jitter ----
+
+static Samples* jitterSamples = nullptr;
+static std::atomic<uint64_t> firstFiring(0);
+static std::atomic<uint64_t> lastFiring(0);
+static std::atomic<uint32_t> jitterFirings(0);
+
+static void firingJitter(uint32_t periodMs){
+    const uint32_t target = quick ? 100 : 500;
+    Samples samples;
+    samples.reserve(target);
+    jitterSamples = &samples;
+    firstFiring = 0;
+    lastFiring = 0;
+    jitterFirings = 0;
+
+    static uint32_t period;
+    period = periodMs;
+
+    Scheduler scheduler;
+    scheduler.addTask([](){
+        uint64_t now = nowNs();
+        uint64_t last = lastFiring.exchange(now);
+        if (!last){
+            firstFiring = now;
+        } else {
+            int64_t deviation = int64_t(now - last) - int64_t(period) * 1000000;
+            jitterSamples->add(uint64_t(deviation < 0 ? -deviation : deviation));
+        }
+        jitterFirings++;
+    }, ScheduleParams(int(periodMs), TimeUnit::Milliseconds, ExecutionPolicy::Inline));
+    scheduler.run();
+
+    while (jitterFirings.load() < target + 1){
+        delay(periodMs);
+    }
+    scheduler.stop();
+
+    // deviation of the average period, anchored deadlines keep it near zero
+    uint32_t periods = jitterFirings.load() - 1;
+    double drift = (double(lastFiring.load() - firstFiring.load()) / periods - double(period) * 1e6) / 1000.0;
+
+    printf("%4lu ms period  |jitter| p50 %7.1f us  p90 %7.1f us  p99 %7.1f us  max %7.1f us  drift %6.2f us/period  (wakeups %lu)\n",
+        (unsigned long)periodMs, samples.percentile(50) / 1000.0, samples.percentile(90) / 1000.0,
+        samples.percentile(99) / 1000.0, samples.percentile(100) / 1000.0, drift, (unsigned long)scheduler.wakeups());
+    jitterSamples = nullptr;
+}
+
+// ---- Sharded scheduler ----
+
+static std::atomic<uint32_t> shardFirings(0);
+
+// inline job of about 20 us
+static void busyJob(){
+    uint64_t end = nowNs() + 20000;
+    while (nowNs() < end) {}
+    shardFirings++;
+}
+
+// 200 jobs every millisecond, 4 times what one core can run inline
+template <typename _Scheduler>
+static void schedulerThroughput(const char* name, _Scheduler& scheduler){
+    for (int i = 0; i < 200; i++){
+        scheduler.addTask(busyJob, ScheduleParams(1, TimeUnit::Milliseconds, ExecutionPolicy::Inline));
+    }
+    shardFirings = 0;
+    uint64_t start = nowNs();
+    scheduler.run();
+    delay(quick ? 500 : 2000);
+    scheduler.stop();
+    double seconds = (nowNs() - start) / 1e9;
+
+    printf("%-34s %10.0f firings/s\n", name, shardFirings.load() / seconds);
+}
+
+// ---- Timer slack ----
+
+static std::atomic<uint32_t> slackFirings(0);
+
+// 40 inline jobs with periods of 20 to 59 ms, every one a separate deadline
+static void timerSlack(uint32_t slackMs){
+    Scheduler scheduler;
+    for (int i = 0; i < 40; i++){
+        scheduler.addTask([](){ slackFirings++; }, ScheduleParams(20 + i, TimeUnit::Milliseconds, ExecutionPolicy::Inline)
+            .setOffset(i % 7)
+            .setSlack(int(slackMs)));
+    }
+    slackFirings = 0;
+    scheduler.run();
+    delay(quick ? 500 : 2000);
+    scheduler.stop();
+
+    uint32_t wakeups = scheduler.wakeups();
+    uint32_t maxLate = 0;
+    for (size_t i = 0; i < scheduler.taskCount(); i++){
+        maxLate = std::max<uint32_t>(maxLate, scheduler.stats(i).maxLateness);
+    }
+    printf("slack %2lu ms  %6lu firings  %6lu wakeups  %5.2f firings/wakeup  max late %lu ms\n",
+        (unsigned long)slackMs, (unsigned long)slackFirings.load(), (unsigned long)wakeups,
+        wakeups ? double(slackFirings.load()) / wakeups : 0.0, (unsigned long)maxLate);
+}
+
+// ---- Argument passing ----
+
+// 4 KB argument, counts how often it's copied and moved
+struct Payload{
+    static std::atomic<uint32_t> copies;
+    static std::atomic<uint32_t> moves;
+
+    uint8_t data[4096];
+
+    Payload(){
+        memset(data, 1, sizeof(data));
+    }
+
+    Payload(const Payload& other){
+        memcpy(data, other.data, sizeof(data));
+        copies++;
+    }
+
+    Payload(Payload&& other){
+        memcpy(data, other.data, sizeof(data));
+        moves++;
+    }
+
+    Payload& operator=(const Payload& other){
+        memcpy(data, other.data, sizeof(data));
+        copies++;
+        return *this;
+    }
+
+    Payload& operator=(Payload&& other){
+        memcpy(data, other.data, sizeof(data));
+        moves++;
+        return *this;
+    }
+};
+
+std::atomic<uint32_t> Payload::copies(0);
+std::atomic<uint32_t> Payload::moves(0);
+
+enum class PassBy{ Copy, Move, UniquePtr };
+
+// `AsyncTask::run()` on the pool with a 4 KB argument, taken by value by the task function
+static void payloadThroughput(const char* name, Executor* executor, PassBy pass){
+    const uint32_t jobs = quick ? 5000 : 50000;
+    const uint32_t inFlight = 8;
+    completed = 0;
+    Payload::copies = 0;
+    Payload::moves = 0;
+    Payload payload;
+
+    uint64_t start = nowNs();
+    for (uint32_t i = 0; i < jobs; i++){
+        while (i - completed.load() >= inFlight){
+            taskYIELD();
+        }
+        if (pass == PassBy::UniquePtr){
+            AsyncTask<std::unique_ptr<Payload>> task(TaskParams().setExecutor(executor), [](std::unique_ptr<Payload> p){
+                completed += p->data[0];
+            });
+            task(std::unique_ptr<Payload>(new Payload()));
+        } else {
+            AsyncTask<Payload> task(TaskParams().setExecutor(executor), [](Payload p){
+                completed += p.data[0];
+            });
+            if (pass == PassBy::Copy){
+                task(payload);
+            } else {
+                task(std::move(payload));
+            }
+        }
+    }
+    while (completed.load() < jobs){
+        taskYIELD();
+    }
+    double seconds = (nowNs() - start) / 1e9;
+
+    printf("%-34s %10.0f runs/s  %4.1f copies/run  %4.1f moves/run\n", name, jobs / seconds,
+        double(Payload::copies.load()) / jobs, double(Payload::moves.load()) / jobs);
+}
+
+// ---- Channel throughput ----
+
+static const uint32_t channelEnd = 0xffffffff;
+
+// one task sends integers to another through a FreeRTOS queue, item by item
+static void queueThroughput(const char* name){
+    const uint32_t items = quick ? 100000 : 1000000;
+    QueueHandle_t queue = xQueueCreate(64, sizeof(uint32_t));
+    std::atomic<uint32_t> received(0);
+
+    AsyncTask<> consumer([queue, &received](){
+        uint32_t item;
+        while (xQueueReceive(queue, &item, portMAX_DELAY) == pdTRUE && item != channelEnd){
+            received++;
+        }
+    });
+
+    uint64_t start = nowNs();
+    consumer.run();
+    for (uint32_t i = 0; i < items; i++){
+        xQueueSend(queue, &i, portMAX_DELAY);
+    }
+    xQueueSend(queue, &channelEnd, portMAX_DELAY);
+    while (received.load() < items){
+        taskYIELD();
+    }
+    double seconds = (nowNs() - start) / 1e9;
+    delay(10);
+    vQueueDelete(queue);
+
+    printf("%-34s %10.0f items/s\n", name, items / seconds);
+}
+
+// the same through a `Channel`, received `batch` items at a time
+template <typename _Channel>
+static void channelThroughput(const char* name, _Channel& channel, size_t batch){
+    const uint32_t items = quick ? 100000 : 1000000;
+    std::atomic<uint32_t> received(0);
+
+    AsyncTask<> consumer([&channel, &received, batch](){
+        uint32_t buffer[32];
+        size_t count;
+        while ((count = channel.recvMany(buffer, batch)) > 0){
+            received += uint32_t(count);
+        }
+    });
+
+    uint64_t start = nowNs();
+    consumer.run();
+    for (uint32_t i = 0; i < items; i++){
+        channel.send(i);
+    }
+    channel.close();
+    while (received.load() < items){
+        taskYIELD();
+    }
+    double seconds = (nowNs() - start) / 1e9;
+    delay(10);
+
+    printf("%-34s %10.0f items/s\n", name, items / seconds);
+}
+
+// ---- Parallel for ----
+
+static const size_t firTaps = 16;
+
+// 16-tap moving average of `input` into `output`, for the samples `[begin, end)`
+static void fir(const float* input, float* output, size_t begin, size_t end){
+    for (size_t i = begin; i < end; i++){
+        float sum = 0;
+        for (size_t tap = 0; tap < firTaps; tap++){
+            sum += input[i + tap];
+        }
+        output[i] = sum * (1.0f / firTaps);
+    }
+}
+
+// the way it's done without `parallelFor()`: one task per core, joined with a semaphore
+struct FirHalf{
+    const float* input;
+    float* output;
+    size_t begin;
+    size_t end;
+    SemaphoreHandle_t done;
+};
+
+static void firHalf(FirHalf* half){
+    fir(half->input, half->output, half->begin, half->end);
+    xSemaphoreGive(half->done);
+}
+
+static void parallelForCost(Executor& executor, size_t samples){
+    const uint32_t runs = quick ? 200 : 2000;
+    std::vector<float> input(samples + firTaps, 1.0f);
+    std::vector<float> output(samples);
+
+    uint64_t start = nowNs();
+    for (uint32_t run = 0; run < runs; run++){
+        fir(input.data(), output.data(), 0, samples);
+    }
+    double serial = double(nowNs() - start) / runs / 1000;
+
+    SemaphoreHandle_t done = xSemaphoreCreateCounting(2, 0);
+    start = nowNs();
+    for (uint32_t run = 0; run < runs; run++){
+        FirHalf halves[2] = {
+            {input.data(), output.data(), 0, samples / 2, done},
+            {input.data(), output.data(), samples / 2, samples, done},
+        };
+        for (int core = 0; core < 2; core++){
+            AsyncTask<FirHalf*> task(TaskParams().setUsePinnedCore(true).setCore(core), firHalf);
+            task(&halves[core]);
+        }
+        xSemaphoreTake(done, portMAX_DELAY);
+        xSemaphoreTake(done, portMAX_DELAY);
+    }
+    double tasks = double(nowNs() - start) / runs / 1000;
+    vSemaphoreDelete(done);
+
+    start = nowNs();
+    for (uint32_t run = 0; run < runs; run++){
+        parallelFor(executor, 0, samples, 256, [&](size_t begin, size_t end){
+            fir(input.data(), output.data(), begin, end);
+        });
+    }
+    double parallel = double(nowNs() - start) / runs / 1000;
+
+    printf("%6lu samples  serial %9.1f us  two AsyncTasks %9.1f us  parallelFor %9.1f us\n",
+        (unsigned long)samples, serial, tasks, parallel);
+}
+
+// ---- Parallel reduce ----
+
+static float energy(const float* input, size_t begin, size_t end){
+    float sum = 0;
+    for (size_t i = begin; i < end; i++){
+        sum += input[i] * input[i];
+    }
+    return sum;
+}
+
+static void parallelReduceCost(Executor& executor, size_t samples){
+    const uint32_t runs = quick ? 200 : 2000;
+    std::vector<float> input(samples, 0.5f);
+
+    // summed into `result` so the loops aren't optimized away
+    volatile float result = 0;
+    uint64_t start = nowNs();
+    for (uint32_t run = 0; run < runs; run++){
+        result = result + energy(input.data(), 0, samples);
+    }
+    double serial = double(nowNs() - start) / runs / 1000;
+
+    start = nowNs();
+    for (uint32_t run = 0; run < runs; run++){
+        result = result + parallelReduce(executor, 0, samples, 256, 0.0f,
+            [&](size_t begin, size_t end){
+                return energy(input.data(), begin, end);
+            },
+            [](float a, float b){
+                return a + b;
+            });
+    }
+    double parallel = double(nowNs() - start) / runs / 1000;
+
+    printf("%6lu samples  serial %9.1f us  parallelReduce %9.1f us\n",
+        (unsigned long)samples, serial, parallel);
+}
+
+// ---- Static schedule ----
+
+static std::atomic<uint32_t> staticFirings[3];
+
+static void staticSample(){
+    staticFirings[0]++;
+}
+
+static void staticControl(){
+    staticFirings[1]++;
+}
+
+static void staticLog(){
+    staticFirings[2]++;
+}
+
+// 1 ms frames, 100 frames in the hyperperiod
+typedef StaticSchedule<
+    StaticJob<staticSample, 2>,
+    StaticJob<staticControl, 4, 1>,
+    StaticJob<staticLog, 100, 0, ExecutionPolicy::Pooled>
+> BenchTable;
+
+// a job every `period` ms fires `runMs / period` times in `runMs`, ±1: the job with no
+// offset fires right at the start, and the last frame may or may not start before `stop()`
+static bool firingsMatch(uint32_t firings, uint32_t runMs, uint32_t period){
+    uint32_t expected = runMs / period;
+    return firings + 1 >= expected && firings <= expected + 1;
+}
+
+static void staticScheduleCost(Executor& executor){
+    const uint32_t frames = quick ? 100000 : 1000000;
+    const uint32_t runMs = quick ? 200 : 1000;
+    BenchTable table;
+    table.setExecutor(&executor);
+
+    uint64_t start = nowNs();
+    for (uint32_t frame = 0; frame < frames; frame++){
+        table.step();
+    }
+    double step = double(nowNs() - start) / frames;
+    // let the pooled jobs finish before counting again
+    delay(10);
+
+    for (auto& firings : staticFirings){
+        firings = 0;
+    }
+    table.run();
+    delay(runMs);
+    table.stop();
+
+    printf("%u ms frames, %lu frames  step() %6.1f ns/frame\n",
+        (unsigned)BenchTable::frameLength, (unsigned long)BenchTable::frameCount, step);
+    // a frame that starts a whole frame late is only reported, the host isn't a real-time
+    // system, a loaded or single core machine misses 1 ms frames. The late frames catch
+    // up, so the firings still add up
+    bool ok = firingsMatch(staticFirings[0], runMs, 2) && firingsMatch(staticFirings[1], runMs, 4)
+        && firingsMatch(staticFirings[2], runMs, 100);
+    failures += !ok;
+    printf("run() for %u ms  firings %lu / %lu / %lu (expected %u / %u / %u, ±1)  overruns %u  %s\n",
+        (unsigned)runMs, (unsigned long)staticFirings[0].load(), (unsigned long)staticFirings[1].load(),
+        (unsigned long)staticFirings[2].load(), (unsigned)(runMs / 2), (unsigned)(runMs / 4),
+        (unsigned)(runMs / 100), (unsigned)table.overruns(), ok ? "ok" : "FAIL");
+}
+
+// ---- Stack profile ----
+
+// `record()` and `suggest()` per call, with `names` task names in the table
+static void stackProfileCost(size_t names){
+    const uint32_t calls = quick ? 100000 : 1000000;
+    char text[ASYNC_TASKS_STACK_PROFILE_SIZE][16];
+    names = std::min<size_t>(names, ASYNC_TASKS_STACK_PROFILE_SIZE);
+
+    StackProfile::clear();
+    for (size_t i = 0; i < names; i++){
+        snprintf(text[i], sizeof(text[i]), "Job%u", (unsigned)i);
+        StackProfile::record(text[i], 1024);
+    }
+
+    uint64_t start = nowNs();
+    for (uint32_t call = 0; call < calls; call++){
+        StackProfile::record(text[call % names], 1024 + call % 512);
+    }
+    double record = double(nowNs() - start) / calls;
+
+    uint32_t suggested = 0;
+    start = nowNs();
+    for (uint32_t call = 0; call < calls; call++){
+        suggested = StackProfile::suggest(text[call % names], 4096);
+    }
+    double suggest = double(nowNs() - start) / calls;
+
+    size_t exported = StackProfile::exportTo(nullptr, 0);
+    StackProfile::clear();
+
+    printf("%2lu names  record() %6.1f ns  suggest() %6.1f ns (%lu)  exportTo() %5lu bytes\n",
+        (unsigned long)names, record, suggest, (unsigned long)suggested, (unsigned long)exported);
+}
+
+// ---- Cron next firing ----
+
+static void cronNextFiring(const char* text){
+    cron::Expression expression(text);
+
+    // from the last minute of 2025, every firing of 2026
+    struct tm from = {};
+    from.tm_year = 125;
+    from.tm_mon = 11;
+    from.tm_mday = 31;
+    from.tm_hour = 23;
+    from.tm_min = 59;
+
+    uint32_t firings = 0;
+    struct tm time = from;
+    uint64_t start = nowNs();
+    while (expression.next(time, time) && time.tm_year == 126){
+        firings++;
+    }
+    double bitset = double(nowNs() - start) / firings;
+
+    // the same, in local time, with localtime_r / mktime around every call
+    time_t wall = mktime(&from);
+    uint32_t localFirings = 0;
+    start = nowNs();
+    for (;;){
+        wall = expression.next(wall);
+        struct tm local;
+        if (wall == time_t(-1) || !localtime_r(&wall, &local) || local.tm_year != 126){
+            break;
+        }
+        localFirings++;
+    }
+    double localTime = double(nowNs() - start) / localFirings;
+
+    // reference: check every minute of the year with `matches()`
+    uint32_t scanned = 0;
+    time = from;
+    start = nowNs();
+    for (int minute = 0; minute < 365 * 24 * 60; minute++){
+        time.tm_min++;
+        timegm(&time);
+        scanned += expression.matches(time);
+    }
+    double scan = double(nowNs() - start) / scanned;
+
+    printf("%-24s %6lu firings  next %7.1f ns  local time %7.1f ns  minute scan %11.1f ns\n",
+        text, (unsigned long)firings, bitset, localTime, scan);
+}
+
+int main(int argc, char** argv){
+    for (int i = 1; i < argc; i++){
+        if (strcmp(argv[i], "--quick") == 0){
+            quick = true;
+        }
+    }
+
+    TaskPool pool(2, 1024);
+    pool.run();
+    WorkStealingExecutor executor(portNUM_PROCESSORS, 1024);
+    executor.run();
+
+    printHeader("Spawn latency (run() to start of the task function)");
+    spawnLatency("new FreeRTOS task", TaskParams());
+    spawnLatency("StackPool", TaskParams().setStacks(&benchStacks));
+    spawnLatency("TaskPool", TaskParams().setExecutor(&pool));
+    spawnLatency("WorkStealingExecutor", TaskParams().setExecutor(&executor));
+
+    printHeader("Throughput");
+    executorThroughput("TaskPool submit()", pool);
+    executorThroughput("WorkStealingExecutor submit()", executor);
+    asyncTaskThroughput("AsyncTask, new FreeRTOS task", nullptr, quick ? 500 : 5000, 64);
+    asyncTaskThroughput("AsyncTask on TaskPool", &pool, quick ? 20000 : 200000, 512);
+    asyncTaskThroughput("AsyncTask on WorkStealingExecutor", &executor, quick ? 20000 : 200000, 512);
+
+    printHeader("Scheduler tick cost");
+    const uint32_t counts[] = {10, 100, 1000, 10000};
+    for (uint32_t count : counts){
+        tickCost(count);
+    }
+
+    printHeader("Firing jitter");
+    firingJitter(10);
+    firingJitter(100);
+
+    printHeader("Scheduler throughput (inline jobs, more than one core can run)");
+    {
+        Scheduler single;
+        schedulerThroughput("Scheduler", single);
+    }
+    {
+        ShardedScheduler sharded;
+        char name[64];
+        snprintf(name, sizeof(name), "ShardedScheduler, %u shards", (unsigned)sharded.shardCount());
+        schedulerThroughput(name, sharded);
+    }
+
+    printHeader("Timer slack (40 jobs, periods 20 to 59 ms)");
+    timerSlack(0);
+    timerSlack(5);
+    timerSlack(20);
+
+    printHeader("Argument passing (4 KB payload, AsyncTask on TaskPool)");
+    payloadThroughput("lvalue, copied", &pool, PassBy::Copy);
+    payloadThroughput("rvalue, moved", &pool, PassBy::Move);
+    payloadThroughput("std::unique_ptr", &pool, PassBy::UniquePtr);
+
+    printHeader("Channel throughput (uint32_t items, 64 slots, one sender, one receiver)");
+    queueThroughput("xQueueSend / xQueueReceive");
+    {
+        Channel<uint32_t, 64> channel;
+        channelThroughput("Channel, recv()", channel, 1);
+    }
+    {
+        Channel<uint32_t, 64, ChannelMode::Spsc> channel;
+        channelThroughput("Channel Spsc, recv()", channel, 1);
+    }
+    {
+        Channel<uint32_t, 64, ChannelMode::Spsc> channel;
+        channelThroughput("Channel Spsc, recvMany(32)", channel, 32);
+    }
+
+    printHeader("Parallel for (16-tap FIR filter, grain of 256 samples)");
+    const size_t blocks[] = {64, 4096, 65536};
+    for (size_t samples : blocks){
+        parallelForCost(executor, samples);
+    }
+
+    printHeader("Parallel reduce (sum of squares, grain of 256 samples)");
+    for (size_t samples : blocks){
+        parallelReduceCost(executor, samples);
+    }
+
+    printHeader("Static schedule (jobs every 2 ms, 4 ms and 100 ms, the last one pooled)");
+    staticScheduleCost(executor);
+
+    printHeader("Stack profile");
+    const size_t profileNames[] = {1, 8, ASYNC_TASKS_STACK_PROFILE_SIZE};
+    for (size_t names : profileNames){
+        stackProfileCost(names);
+    }
+
+    printHeader("Cron next firing (per firing, over a year)");
+    const char* expressions[] = {"*/5 * * * *", "0,30 8-18 * * MON-FRI", "0 0 13 * FRI", "0 0 1 1 *"};
+    for (const char* expression : expressions){
+        cronNextFiring(expression);
+    }
+
+    pool.stop();
+    executor.stop();
+    if (failures){
+        printf("\n%d check(s) failed\n", failures);
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,77 @@
+/*
+
+ArduinoAsyncTask - Allocation Benchmark
+
+Counts the heap allocations (calls to `operator new`) made by creating and running
+an `AsyncTask` with a capturing lambda.
+
+The task function is stored in an `InplaceFunction`, inside the task object, and is
+moved (not copied) to the running task, so the lambda never allocates. For comparison,
+the same lambda is stored in a `std::function` and copied as many times as the task
+used to copy it (constructor, `operator=`, heap copy), each copy of a capture bigger
+than the small buffer of `std::function` allocates.
+
+Allocations made by FreeRTOS itself (task stack and TCB) go through `pvPortMalloc`
+and are not counted here.
+
+*/
+
+#include <ArduinoAsyncTasks.h>
+#include <functional>
+#include <atomic>
+#include <stdlib.h>
+
+std::atomic<uint32_t> allocations(0);
+
+void* operator new(size_t size){
+    allocations++;
+    return malloc(size);
+}
+
+void operator delete(void* ptr) noexcept{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept{
+    free(ptr);
+}
+
+const int RUNS = 100;
+
+void setup(){
+    Serial.begin(115200);
+}
+
+void loop(){
+    delay(2000);
+
+    // 24 bytes of captures, doesn't fit into the small buffer of std::function
+    uint32_t a = 1, b = 2, c = 3, d = 4, e = 5, f = 6;
+    auto lambda = [a, b, c, d, e, f](int i){
+        volatile uint32_t sum = a + b + c + d + e + f + i;
+        (void)sum;
+    };
+
+    // std::function, constructed and copied 3 times, like a task launch used to do
+    uint32_t before = allocations;
+    for (int i = 0; i < RUNS; i++){
+        std::function<void(int)> fn(lambda);
+        std::function<void(int)> assigned;
+        assigned = fn;
+        std::function<void(int)> heapCopy(assigned);
+        heapCopy(i);
+    }
+    uint32_t stdFunction = allocations - before;
+
+    // AsyncTask with an InplaceFunction, created and run
+    before = allocations;
+    for (int i = 0; i < RUNS; i++){
+        AsyncTask<int> task(TaskParams(2048, 1, "Alloc"), lambda);
+        task(i);
+        delay(2);
+    }
+    uint32_t asyncTask = allocations - before;
+
+    Serial.printf("std::function copies: %.2f allocations per launch\n", float(stdFunction) / RUNS);
+    Serial.printf("AsyncTask::run():     %.2f allocations per launch (task control data and heap copy)\n", float(asyncTask) / RUNS);
+}
@@ -0,0 +1,57 @@
+/*
+
+ArduinoAsyncTask - Futures
+
+Submits jobs to a task pool and waits for their results with a `Future`.
+The waiting task is woken up by a task notification when the result is set,
+the example prints the time from setting the result to the waiter running again.
+
+*/
+
+#include <ArduinoAsyncTasks.h>
+
+TaskPool pool(2, 16);
+
+const int RUNS = 100;
+
+void setup(){
+    Serial.begin(115200);
+    pool.run();
+}
+
+void loop(){
+    delay(2000);
+
+    // Result of a job with arguments
+    Future<int> sum = submit(pool, [](int a, int b){
+        return a + b;
+    }, 2, 3);
+    Serial.printf("2 + 3 = %d\n", sum.get());
+
+    // Waiting with a timeout
+    Future<String> slow = submit(pool, [](){
+        delay(500);
+        return String("done");
+    });
+    if (!slow.waitFor(100)){
+        Serial.println("Not ready after 100 ms");
+    }
+    Serial.println("Slow job: " + slow.get());
+
+    // Wake-up latency, from the end of the job to the waiter
+    uint32_t total = 0, worst = 0;
+    for (int i = 0; i < RUNS; i++){
+        Future<uint32_t> f = submit(pool, [](){
+            delay(1);
+            return (uint32_t)micros();
+        });
+        uint32_t finished = f.get();
+        uint32_t latency = micros() - finished;
+        total += latency;
+        if (latency > worst){
+            worst = latency;
+        }
+    }
+    Serial.printf("Wake-up latency: avg %lu us, max %lu us\n",
+        (unsigned long)(total / RUNS), (unsigned long)worst);
+}
@@ -0,0 +1,138 @@
+/*
+
+ArduinoAsyncTask - ISR Latency
+
+A hardware timer interrupt submits a job every millisecond with `submitFromISR()`,
+the job measures the time from the interrupt to the start of its execution.
+Compared for a `TaskPool` and a `WorkStealingExecutor`, and for the usual
+workaround, a FreeRTOS queue read by a task of our own.
+
+Nothing in the interrupt handler allocates or blocks, the jobs go into
+preallocated lock-free queues.
+
+*/
+
+#include <ArduinoAsyncTasks.h>
+
+const int SAMPLES = 1000;
+
+TaskPool pool(2, 16);
+WorkStealingExecutor executor;
+
+Executor* target = nullptr;
+QueueHandle_t bounceQueue;
+hw_timer_t* timer = nullptr;
+
+volatile uint32_t submittedAt = 0;
+volatile uint32_t samples = 0;
+volatile uint32_t latencySum = 0;
+volatile uint32_t latencyMax = 0;
+volatile uint32_t rejected = 0;
+
+void record(){
+    uint32_t latency = micros() - submittedAt;
+    latencySum += latency;
+    if (latency > latencyMax){
+        latencyMax = latency;
+    }
+    samples++;
+}
+
+void measureJob(void*){
+    record();
+}
+
+void IRAM_ATTR onTimer(){
+    if (samples >= SAMPLES){
+        return;
+    }
+    submittedAt = micros();
+    if (target){
+        if (!target->submitFromISR(measureJob, nullptr)){
+            rejected++;
+        }
+    } else {
+        BaseType_t woken = pdFALSE;
+        uint8_t token = 0;
+        xQueueSendFromISR(bounceQueue, &token, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+}
+
+void bounceTask(void*){
+    uint8_t token;
+    for(;;){
+        if (xQueueReceive(bounceQueue, &token, portMAX_DELAY) == pdTRUE){
+            record();
+        }
+    }
+}
+
+#if ESP_ARDUINO_VERSION_MAJOR >= 3
+void timerSetup(){
+    timer = timerBegin(1000000);
+    timerAttachInterrupt(timer, &onTimer);
+    timerAlarm(timer, 1000, true, 0);
+    timerStop(timer);
+}
+
+void startTimer(){
+    timerStart(timer);
+}
+
+void stopTimer(){
+    timerStop(timer);
+}
+#else
+void timerSetup(){
+    timer = timerBegin(0, 80, true);
+    timerAttachInterrupt(timer, &onTimer, true);
+    timerAlarmWrite(timer, 1000, true);
+}
+
+void startTimer(){
+    timerAlarmEnable(timer);
+}
+
+void stopTimer(){
+    timerAlarmDisable(timer);
+}
+#endif
+
+void measure(const char* name, Executor* executor){
+    samples = 0;
+    latencySum = 0;
+    latencyMax = 0;
+    rejected = 0;
+    target = executor;
+
+    startTimer();
+    while (samples < SAMPLES){
+        delay(10);
+    }
+    stopTimer();
+
+    Serial.printf("%-22s avg %lu us, max %lu us, rejected %lu\n", name,
+        (unsigned long)(latencySum / SAMPLES), (unsigned long)latencyMax, (unsigned long)rejected);
+}
+
+void setup(){
+    Serial.begin(115200);
+
+    pool.setParams(TaskParams(4096, 5, "Pool"));
+    pool.run();
+    executor.setParams(TaskParams(4096, 5, "Worker"));
+    executor.run();
+
+    bounceQueue = xQueueCreate(16, sizeof(uint8_t));
+    xTaskCreate(bounceTask, "Bounce", 4096, nullptr, 5, nullptr);
+
+    timerSetup();
+}
+
+void loop(){
+    delay(2000);
+    measure("TaskPool", &pool);
+    measure("WorkStealingExecutor", &executor);
+    measure("FreeRTOS queue + task", nullptr);
+}
@@ -0,0 +1,80 @@
+/*
+
+ArduinoAsyncTask - Scheduler Benchmark
+
+Measures how much a scheduler tick costs, for 10 to 10000 scheduled tasks.
+Every task has an interval between 1 and 60 seconds, so in each tick only a few
+of them are due. The ticks are driven with `execute()` from `loop()`, and the tasks
+run on an executor that calls them right away, so only the scheduler itself is measured.
+
+Bigger task counts are skipped if there is not enough free memory (10000 tasks need
+a board with PSRAM).
+
+*/
+
+#include <ArduinoAsyncTasks.h>
+#include <Scheduler.h>
+#include <atomic>
+
+// Runs the submitted jobs on the calling task
+class InlineExecutor : public Executor{
+  public:
+    bool submit(_JobFunction fn, void* arg) override{
+        fn(arg);
+        return true;
+    }
+};
+
+InlineExecutor inlineExecutor;
+std::atomic<uint32_t> firings(0);
+
+void measure(uint32_t count){
+    // Rough estimate of the memory needed, with some headroom
+    if (ESP.getFreeHeap() < count * (sizeof(_ScheduledTask) + 32) + 16 * 1024){
+        Serial.printf("%6lu tasks: not enough memory, skipped\n", (unsigned long)count);
+        return;
+    }
+
+    Scheduler scheduler;
+    scheduler.setExecutor(&inlineExecutor);
+    for (uint32_t i = 0; i < count; i++){
+        scheduler.addTask([](){ firings++; }, ScheduleParams().every(1 + i % 60, TimeUnit::Seconds));
+    }
+
+    // The first tick runs every task once
+    scheduler.execute();
+    firings = 0;
+
+    uint32_t ticks = 0, busy = 0, worst = 0;
+    uint32_t start = millis();
+    while (millis() - start < 5000){
+        uint32_t t = micros();
+        scheduler.execute();
+        t = micros() - t;
+
+        busy += t;
+        worst = max(worst, t);
+        ticks++;
+        delay(10);
+    }
+
+    Serial.printf(
+        "%6lu tasks: %4lu ticks, avg %7.1f us/tick, max %6lu us, %5lu firings\n",
+        (unsigned long)count, (unsigned long)ticks, float(busy) / ticks,
+        (unsigned long)worst, (unsigned long)firings.load()
+    );
+}
+
+void setup(){
+    Serial.begin(115200);
+}
+
+void loop(){
+    delay(2000);
+    Serial.println();
+
+    measure(10);
+    measure(100);
+    measure(1000);
+    measure(10000);
+}
@@ -0,0 +1,77 @@
+/*
+
+ArduinoAsyncTask - Scheduler Jitter
+
+The scheduler task sleeps exactly until the next task is due. This example shows:
+- the number of scheduler wakeups, extrapolated to one hour, with only a task every
+  10 minutes scheduled (the scheduler barely wakes up at all)
+- the firing jitter of a 100 ms task, the difference between the measured interval
+  and the requested one
+
+*/
+
+#include <ArduinoAsyncTasks.h>
+#include <Scheduler.h>
+
+// Runs the submitted jobs on the calling task (here, the scheduler task),
+// so the measurement doesn't include the FreeRTOS task creation
+class InlineExecutor : public Executor{
+  public:
+    bool submit(_JobFunction fn, void* arg) override{
+        fn(arg);
+        return true;
+    }
+};
+
+InlineExecutor inlineExecutor;
+Scheduler scheduler;
+
+volatile uint32_t lastFiring = 0;
+volatile uint32_t firings = 0;
+volatile uint32_t jitterSum = 0;
+volatile uint32_t jitterMax = 0;
+
+const uint32_t MEASURE_MS = 10000;
+
+void setup(){
+    Serial.begin(115200);
+
+    scheduler.setExecutor(&inlineExecutor);
+    scheduler.addTask([](){
+        Serial.println("10 minutes passed");
+    }, ScheduleParams().every(10, TimeUnit::Minutes));
+    scheduler.run();
+
+    // Idle scheduler, with only the 10 minute task
+    uint32_t before = scheduler.wakeups();
+    delay(MEASURE_MS);
+    uint32_t idle = scheduler.wakeups() - before;
+    Serial.printf("Idle: %lu wakeups in %lu ms, %lu per hour\n",
+        (unsigned long)idle, (unsigned long)MEASURE_MS, (unsigned long)(idle * (3600000UL / MEASURE_MS)));
+
+    // Add a 100 ms task and measure its interval
+    scheduler.addTask([](){
+        uint32_t now = micros();
+        if (lastFiring){
+            int32_t jitter = int32_t(now - lastFiring) - 100000;
+            uint32_t absJitter = jitter < 0 ? -jitter : jitter;
+            jitterSum += absJitter;
+            if (absJitter > jitterMax){
+                jitterMax = absJitter;
+            }
+            firings++;
+        }
+        lastFiring = now;
+    }, ScheduleParams().every(100, TimeUnit::Milliseconds));
+
+    before = scheduler.wakeups();
+    delay(MEASURE_MS);
+    uint32_t busy = scheduler.wakeups() - before;
+    Serial.printf("100 ms task: %lu wakeups per hour, jitter avg %lu us, max %lu us\n",
+        (unsigned long)(busy * (3600000UL / MEASURE_MS)),
+        (unsigned long)(jitterSum / (firings ? firings : 1)), (unsigned long)jitterMax);
+}
+
+void loop(){
+    delay(1000);
+}
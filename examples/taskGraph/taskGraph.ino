@@ -0,0 +1,55 @@
+/*
+
+ArduinoAsyncTask - Task Graph
+
+A sensor processing pipeline as a task graph: read the sensors, filter the
+accelerometer and the gyroscope in parallel (on both cores), then fuse the results.
+A watchdog node runs as soon as any of the filters is done.
+
+The stages don't share any mutex, a stage starts when its dependencies are done.
+
+*/
+
+#include <ArduinoAsyncTasks.h>
+
+WorkStealingExecutor executor;
+TaskGraph graph;
+
+float accel = 0, gyro = 0, fused = 0;
+uint32_t firstFilterDone = 0;
+
+void setup(){
+    Serial.begin(115200);
+
+    auto read = graph.add([](){
+        accel = analogRead(34) / 4095.0f;
+        gyro = analogRead(35) / 4095.0f;
+    });
+    auto accelFilter = read.then([](){
+        accel = accel * 0.9f + 0.05f;
+        delay(2);
+    });
+    auto gyroFilter = read.then([](){
+        gyro = gyro * 0.98f;
+        delay(3);
+    });
+    graph.whenAll({accelFilter, gyroFilter}, [](){
+        fused = 0.7f * accel + 0.3f * gyro;
+    });
+    graph.whenAny({accelFilter, gyroFilter}, [](){
+        firstFilterDone = micros();
+    });
+
+    executor.run();
+}
+
+void loop(){
+    uint32_t start = micros();
+    graph.run(executor);
+    graph.wait();
+    uint32_t end = micros();
+
+    Serial.printf("fused %.3f, first filter after %lu us, graph took %lu us\n",
+        fused, (unsigned long)(firstFilterDone - start), (unsigned long)(end - start));
+    delay(1000);
+}
@@ -0,0 +1,78 @@
+/*
+
+ArduinoAsyncTask - Task Pool Benchmark
+
+Compares running short jobs with a new FreeRTOS task for every `run()` (the default)
+against submitting them to a `TaskPool` of long-lived workers.
+
+For both modes it prints:
+- spawn-to-start latency, the time between `run()` and the first line of the job
+- throughput, the number of jobs per second until all of them are finished
+
+*/
+
+#include <ArduinoAsyncTasks.h>
+#include <atomic>
+
+// Number of jobs started in each measurement
+const uint32_t JOBS = 200;
+
+std::atomic<uint32_t> finished(0);
+std::atomic<uint32_t> latencySum(0);
+std::atomic<uint32_t> latencyMax(0);
+
+TaskPool pool(2, JOBS);
+
+// The job, records the time since it was started with `run()`
+void job(uint32_t submitted){
+    uint32_t latency = micros() - submitted;
+    latencySum += latency;
+
+    uint32_t max = latencyMax.load();
+    while (latency > max && !latencyMax.compare_exchange_weak(max, latency)) {}
+
+    finished++;
+}
+
+void measure(const char* name, const TaskParams& params){
+    finished = 0;
+    latencySum = 0;
+    latencyMax = 0;
+
+    uint32_t start = micros();
+    for (uint32_t i = 0; i < JOBS; i++){
+        AsyncTask<uint32_t> task(params, job);
+        task(micros());
+    }
+
+    // Wait for all the jobs, give up after 10 seconds (e.g. out of memory for new tasks)
+    while (finished < JOBS && micros() - start < 10000000UL){
+        delay(1);
+    }
+    uint32_t elapsed = micros() - start;
+    uint32_t done = finished;
+
+    Serial.printf(
+        "%-12s jobs: %3lu, latency avg: %6lu us, max: %6lu us, throughput: %7.0f jobs/s\n",
+        name, (unsigned long)done, (unsigned long)(latencySum / (done ? done : 1)),
+        (unsigned long)latencyMax.load(), done * 1e6 / elapsed
+    );
+}
+
+void setup(){
+    Serial.begin(115200);
+
+    // Same priority as the jobs, so they can start right after being submitted
+    pool.setParams(TaskParams(2048, 2, "Pool"));
+    pool.run();
+}
+
+void loop(){
+    delay(2000);
+
+    Serial.println("\nTask per run()");
+    measure("xTaskCreate", TaskParams(2048, 2, "Job"));
+
+    Serial.println("TaskPool");
+    measure("TaskPool", TaskParams(2048, 2, "Job").setExecutor(&pool));
+}
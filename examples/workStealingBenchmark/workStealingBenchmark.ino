@@ -0,0 +1,79 @@
+/*
+
+ArduinoAsyncTask - Work Stealing Benchmark
+
+Runs a burst of CPU-bound jobs in three ways and prints the throughput of each:
+- a new FreeRTOS task for every job, all pinned to core 0 (`TaskParams::setCore`)
+- a new FreeRTOS task for every job, without core affinity
+- `WorkStealingExecutor`, one worker per core, idle workers steal from busy ones
+
+Every job also counts on which core it ran, to show how the load was spread.
+
+*/
+
+#include <ArduinoAsyncTasks.h>
+#include <atomic>
+
+// Number of jobs in a burst
+const uint32_t JOBS = 200;
+
+// Iterations of the busy loop in every job
+const uint32_t WORK = 20000;
+
+std::atomic<uint32_t> finished(0);
+std::atomic<uint32_t> perCore[portNUM_PROCESSORS];
+
+WorkStealingExecutor executor(portNUM_PROCESSORS, JOBS);
+
+void job(uint32_t seed){
+    // Some CPU work, that can't be optimized away
+    volatile uint32_t x = seed;
+    for (uint32_t i = 0; i < WORK; i++){
+        x = x * 1664525UL + 1013904223UL;
+    }
+
+    perCore[xPortGetCoreID()]++;
+    finished++;
+}
+
+void measure(const char* name, const TaskParams& params){
+    finished = 0;
+    for (int i = 0; i < portNUM_PROCESSORS; i++){
+        perCore[i] = 0;
+    }
+
+    uint32_t start = micros();
+    for (uint32_t i = 0; i < JOBS; i++){
+        AsyncTask<uint32_t> task(params, job);
+        task(i);
+    }
+
+    // Wait for all the jobs, give up after 20 seconds (e.g. out of memory for new tasks)
+    while (finished < JOBS && micros() - start < 20000000UL){
+        delay(1);
+    }
+    uint32_t elapsed = micros() - start;
+    uint32_t done = finished;
+
+    Serial.printf("%-14s jobs: %3lu, %7.0f jobs/s, per core:", name, (unsigned long)done, done * 1e6 / elapsed);
+    for (int i = 0; i < portNUM_PROCESSORS; i++){
+        Serial.printf(" %lu", (unsigned long)perCore[i].load());
+    }
+    Serial.println();
+}
+
+void setup(){
+    Serial.begin(115200);
+
+    executor.setParams(TaskParams(2048, 1, "Worker"));
+    executor.run();
+}
+
+void loop(){
+    delay(2000);
+    Serial.println();
+
+    measure("pinned core 0", TaskParams(2048, 1, "Job").setUsePinnedCore(true).setCore(0));
+    measure("unpinned", TaskParams(2048, 1, "Job"));
+    measure("work stealing", TaskParams(2048, 1, "Job").setExecutor(&executor));
+}
@@ -11,5 +11,12 @@
 #endif
 
 #include "AsyncTask.h"
+#include "TaskPool.h"
+#include "WorkStealingExecutor.h"
+#include "Future.h"
+#include "TaskGraph.h"
+#include "Channel.h"
+#include "Parallel.h"
+#include "heap_guard.h"
 
 using namespace async_tasks;
\ No newline at end of file
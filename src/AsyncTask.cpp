@@ -4,49 +4,160 @@ BEGIN_TASKS_NAMESPACE
 
 // void AsyncTask specializations with no parameters
 
-using _TaskType = std::function<void()>;
+using _TaskType = InplaceFunction<void()>;
 
 
+// Task data of the `AsyncTask` running on the current thread
+static thread_local _TaskData* _currentTaskData = nullptr;
+
+ObjectPool<_TaskData>& _TaskData::_pool(){
+    static ObjectPool<_TaskData> pool;
+    return pool;
+}
+
+_TaskData* _TaskData::_swapCurrent(_TaskData* data){
+    _TaskData* previous = _currentTaskData;
+    _currentTaskData = data;
+    return previous;
+}
+
+_TaskData* _TaskData::_current(){
+    return _currentTaskData;
+}
+
+void _TaskData::_finish(){
+    for(;;){
+        _TaskSignal signal = _signal.load();
+        // `pause()` is about to suspend this task, let it, we continue after `resume()`
+        if (signal == _TaskSignal::PAUSING || signal == _TaskSignal::PAUSE){
+            vTaskDelay(1);
+            continue;
+        }
+        if (_transition(signal, _TaskSignal::DONE)){
+            // the FreeRTOS task is about to be deleted, `pause()` and `stop()` don't touch it anymore
+            _handle.store(NULL);
+            return;
+        }
+    }
+}
+
+PoolStats BaseAsyncTask::taskDataStats(){
+    return _TaskData::_pool().stats();
+}
+
+bool BaseAsyncTask::stopRequested(){
+    _TaskData* data = _TaskData::_current();
+    return data && data->_signal.load(std::memory_order_relaxed) == _TaskSignal::STOP;
+}
+
 void BaseAsyncTask::stop(){
     // The task can be deleted only in the `taskWrapper` function, so we must
     // send a signal to the task to stop it, and then delete it in the `taskWrapper`
-    if (_data && _data->_signal == _TaskSignal::RUN && xSemaphoreTake(_data->_mutex, portMAX_DELAY) == pdTRUE){
-        _data->_signal = _TaskSignal::STOP;
-        xSemaphoreGive(_data->_mutex);
+    if (!_data){
+        return;
+    }
+    for(;;){
+        _TaskSignal signal = _data->_signal.load();
+        if (signal == _TaskSignal::RUN && _data->_transition(signal, _TaskSignal::STOP)){
+            return;
+        }
+        // a paused task is resumed, so it can see the signal and return
+        if (signal == _TaskSignal::PAUSE && _data->_transition(signal, _TaskSignal::STOP)){
+            vTaskResume(_data->_handle.load());
+            return;
+        }
+        if (signal == _TaskSignal::PAUSING){
+            taskYIELD();
+            continue;
+        }
+        if (signal != _TaskSignal::RUN && signal != _TaskSignal::PAUSE){
+            return;
+        }
     }
 }
 
 void BaseAsyncTask::pause(){
-    if (_data && _data->_signal == _TaskSignal::RUN && xSemaphoreTake(_data->_mutex, portMAX_DELAY) == pdTRUE){
-        vTaskSuspend(_data->_handle);
-        _data->_signal = _TaskSignal::PAUSE;
-        xSemaphoreGive(_data->_mutex);
+    // Tasks running on an executor don't have their own FreeRTOS task to suspend.
+    // While `PAUSING` the task can't finish, so the handle stays valid
+    TaskHandle_t handle = _data ? _data->_handle.load() : NULL;
+    if (handle && _data->_transition(_TaskSignal::RUN, _TaskSignal::PAUSING)){
+        vTaskSuspend(handle);
+        _data->_signal.store(_TaskSignal::PAUSE);
     }
 }
 
 void BaseAsyncTask::resume(){
-    if(_data && _data->_signal == _TaskSignal::PAUSE && xSemaphoreTake(_data->_mutex, portMAX_DELAY) == pdTRUE){
-        vTaskResume(_data->_handle);
-        _data->_signal = _TaskSignal::RUN;
-        xSemaphoreGive(_data->_mutex);
+    TaskHandle_t handle = _data ? _data->_handle.load() : NULL;
+    if (handle && _data->_transition(_TaskSignal::PAUSE, _TaskSignal::RUN)){
+        vTaskResume(handle);
+    }
+}
+
+TaskHandle_t BaseAsyncTask::_createTask(
+    TaskFunction_t fn, const char* name, uint32_t stackSize, void* param, UBaseType_t priority,
+    const TaskParams& params
+){
+    TaskHandle_t handle = NULL;
+    if (params.stacks){
+        handle = params.stacks->_create(fn, name, param, priority, params.usePinnedCore ? params.core : tskNO_AFFINITY);
+    }
+#if !ASYNC_TASKS_STATIC
+    // no stacks given, or all of them are used
+    if (!handle && params.usePinnedCore){
+        xTaskCreatePinnedToCore(fn, name, stackSize, param, priority, &handle, params.core);
+    } else if (!handle){
+        xTaskCreate(fn, name, stackSize, param, priority, &handle);
     }
+#endif
+    return handle;
+}
+
+void BaseAsyncTask::_exitTask(){
+    // doesn't return for a task on a `StackPool`
+    BaseStackPool::_exitCurrent();
+    vTaskDelete(NULL);
+}
+
+void BaseAsyncTask::_killTask(TaskHandle_t handle, BaseStackPool* stacks){
+    if (!stacks || !stacks->_release(handle)){
+        vTaskDelete(handle);
+    }
+}
+
+bool BaseAsyncTask::_launch(TaskFunction_t wrapper, _JobFunction jobWrapper, void* task){
+    if (_params.executor && _params.executor->submit(jobWrapper, task)){
+        return true;
+    }
+    uint32_t stackSize = uint32_t(_params.stackSize);
+    if (_params.stacks){
+        stackSize = _params.stacks->stackSize();
+    } else if (_params.autoStackSize){
+        stackSize = StackProfile::suggest(_params.name, stackSize);
+    }
+    // set before the task can read it
+    _data->_stackSize = stackSize;
+    // the task publishes its handle itself, see `_taskWrapper()`
+    TaskHandle_t handle = _createTask(wrapper, _params.name, stackSize, task, _params.priority, _params);
+    return handle != NULL;
 }
 
 AsyncTask<>::AsyncTask():
     AsyncTask(TaskParams(), nullptr) {}
 
 AsyncTask<>::AsyncTask(_TaskType task):
-    AsyncTask(TaskParams(), task) {}
+    AsyncTask(TaskParams(), std::move(task)) {}
 
 AsyncTask<>::AsyncTask(const TaskParams& params):
     AsyncTask(params, nullptr) {}
 
 AsyncTask<>::AsyncTask(const TaskParams& params, _TaskType task):
-    BaseAsyncTask(params), _task(task) {}
+    BaseAsyncTask(params), _task(std::move(task)) {}
 
-AsyncTask<>::AsyncTask(const AsyncTask& other){
-    *this = other;
-}
+AsyncTask<>::AsyncTask(const AsyncTask& other):
+    BaseAsyncTask(other._params), _task(other._task) {}
+
+AsyncTask<>::AsyncTask(AsyncTask&& other):
+    BaseAsyncTask(other._params), _task(std::move(other._task)) {}
 
 AsyncTask<>& AsyncTask<>::setParams(const TaskParams& params){
     _params = params;
@@ -54,30 +165,33 @@ AsyncTask<>& AsyncTask<>::setParams(const TaskParams& params){
 }
 
 AsyncTask<>& AsyncTask<>::setTask(_TaskType task){
-    _task = task;
+    _task = std::move(task);
     return *this;
 }
 
 
-void AsyncTask<>::run(){
+bool AsyncTask<>::run(){
     // If the task is already running, return
     if (_data){
-        return;
+        return false;
     }
     if (_task){
-        _data = new _TaskData();
-        if(_params.usePinnedCore){
-            xTaskCreatePinnedToCore(
-                _taskWrapper<void>, _params.name.c_str(), _params.stackSize,
-                copy(), _params.priority, &_data->_handle, _params.core
-            );
-            return;
+        _data = _TaskData::_pool().create();
+        AsyncTask<>* task = _data ? _release() : nullptr;
+        if (task && _launch(_taskWrapper<void>, _jobWrapper<>, task)){
+            return true;
+        }
+        // out of pool slots or stacks (static mode), keep the task so it can be run again
+        if (task){
+            _task = std::move(task->_task);
+            _deleteTask<>(task, false);
+        }
+        if (_data){
+            _data->_release();
+            _data = nullptr;
         }
-        xTaskCreate(
-            _taskWrapper<void>, _params.name.c_str(), _params.stackSize,
-            copy(), _params.priority, &_data->_handle
-        );
     }
+    return false;
 }
 
 void AsyncTask<>::operator()(){
@@ -96,12 +210,45 @@ AsyncTask<>& AsyncTask<>::operator=(const AsyncTask<>& other){
     return *this;
 }
 
+AsyncTask<>& AsyncTask<>::operator=(AsyncTask<>&& other){
+    _params = other._params;
+    _task = std::move(other._task);
+    return *this;
+}
+
 AsyncTask<>* AsyncTask<>::copy() const{
-    auto ptr = new AsyncTask<>(*this);
+    auto ptr = _pool().create(*this);
+    if (!ptr){
+        return nullptr;
+    }
     ptr->_data = _data;
+    if (_data){
+        _data->_acquire();
+    }
     return ptr;
 }
 
+AsyncTask<>* AsyncTask<>::_release(){
+    auto ptr = _pool().create(_params, std::move(_task));
+    if (!ptr){
+        return nullptr;
+    }
+    ptr->_data = _data;
+    if (_data){
+        _data->_acquire();
+    }
+    return ptr;
+}
+
+ObjectPool<AsyncTask<>>& AsyncTask<>::_pool(){
+    static ObjectPool<AsyncTask<>> pool;
+    return pool;
+}
+
+PoolStats AsyncTask<>::poolStats(){
+    return _pool().stats();
+}
+
 
 END_TASKS_NAMESPACE
 
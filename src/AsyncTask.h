@@ -1,17 +1,60 @@
 #pragma once
 
-#include <Arduino.h>
+#include "port.h"
 
 #include "namespaces.h"
 #include <functional>
 #include <tuple>
 #include <memory>
+#include <atomic>
+#include <string>
+#include <string.h>
 
 // `apply` implementation for tuples
 #include "tuple.h"
+#include "Executor.h"
+#include "inplace_function.h"
+#include "object_pool.h"
+#include "stack_profile.h"
+#include "stack_pool.h"
 
 BEGIN_TASKS_NAMESPACE
 
+/**
+ * Name of a task, copied into a fixed buffer, so copying it doesn't allocate.
+ * Names longer than FreeRTOS keeps (`configMAX_TASK_NAME_LEN - 1` characters)
+ * are truncated, like FreeRTOS does
+*/
+struct TaskName{
+    char text[configMAX_TASK_NAME_LEN];
+
+    TaskName(const char* name = "Task"){
+        *this = name;
+    }
+
+    TaskName(const std::string& name){
+        *this = name.c_str();
+    }
+
+    TaskName& operator=(const char* name){
+        strncpy(text, name ? name : "", sizeof(text) - 1);
+        text[sizeof(text) - 1] = '\0';
+        return *this;
+    }
+
+    TaskName& operator=(const std::string& name){
+        return *this = name.c_str();
+    }
+
+    const char* c_str() const{
+        return text;
+    }
+
+    operator const char*() const{
+        return text;
+    }
+};
+
 /**
   * Task parameters, used to create a task, has information about the task:
   * - stack size (default is 4096)
@@ -19,6 +62,9 @@ BEGIN_TASKS_NAMESPACE
   * - name (default is "Task")
   * - use pinned core (default is false)
   * - core (default is 0)
+  * - executor (default is nullptr, a new FreeRTOS task is created for each run)
+  * - auto stack size (default is false, see `StackProfile`)
+  * - stacks (default is nullptr, the stack is allocated by FreeRTOS, see `StackPool`)
 */
 struct TaskParams{
     // stack size, default is 4096
@@ -27,19 +73,33 @@ struct TaskParams{
     // priority of the task, default is tskIDLE_PRIORITY, probably shouldn't be changed
     int priority = tskIDLE_PRIORITY;
 
-    // name of the task, default is "Task"
-    std::string name = "Task";
+    // name of the task, default is "Task", copied into the parameters (see `TaskName`),
+    // copying the parameters (every run of a task does) doesn't allocate
+    TaskName name = "Task";
 
     // use pinned core, default is false
     bool usePinnedCore = false;
 
     // core to pin the task to (0 or 1), default is 0 (if usePinnedCore is true)
     int core = 0;
+
+    // executor running the task (for example a `TaskPool`), default is nullptr,
+    // if set, the other parameters are ignored and the task runs on the executor's tasks
+    Executor* executor = nullptr;
+
+    // size the stack from the peak recorded for `name` (see `StackProfile`),
+    // `stackSize` is the upper bound, default is false
+    bool autoStackSize = false;
+
+    // preallocated stacks the task is created on (with `xTaskCreateStatic`), default is
+    // nullptr, if set `stackSize` is ignored, when all are used the stack is allocated
+    // by FreeRTOS, or in static mode the task doesn't start
+    BaseStackPool* stacks = nullptr;
     
     TaskParams(
         int stackSize = 4096, 
         int priority = tskIDLE_PRIORITY, 
-        std::string name = "Task", 
+        const TaskName& name = "Task", 
         bool usePinnedCore = false, 
         int core = 0
     ): stackSize(stackSize), priority(priority), name(name),
@@ -55,6 +115,9 @@ struct TaskParams{
         name = other.name;
         usePinnedCore = other.usePinnedCore;
         core = other.core;
+        executor = other.executor;
+        autoStackSize = other.autoStackSize;
+        stacks = other.stacks;
         return *this;
     }
 
@@ -68,6 +131,11 @@ struct TaskParams{
         return *this;
     }
 
+    TaskParams& setName(const char* n){
+        name = n;
+        return *this;
+    }
+
     TaskParams& setName(const std::string& n){
         name = n;
         return *this;
@@ -82,6 +150,21 @@ struct TaskParams{
         core = c;
         return *this;
     }
+
+    TaskParams& setExecutor(Executor* e){
+        executor = e;
+        return *this;
+    }
+
+    TaskParams& setAutoStackSize(bool use){
+        autoStackSize = use;
+        return *this;
+    }
+
+    TaskParams& setStacks(BaseStackPool* pool){
+        stacks = pool;
+        return *this;
+    }
 };
 
 
@@ -94,27 +177,74 @@ enum class _TaskSignal{
     STOP = 1,
     PAUSE = 2,
     RUN = 3,
+    // being suspended by `pause()`
+    PAUSING = 4,
+    // the task function returned, the FreeRTOS task is about to be deleted
+    DONE = 5,
 };
 
 /**
  * Task data, used to store the task handle.
  * 
- * To pass the `TaskHandle_t` to the task function, we need to store it in the heap.
- * Also, we need to store the signal that was sent to the task, and a mutex to protect
- * the signal
+ * To pass the `TaskHandle_t` to the task function, we need to store it in the heap
+ * (a slot of `_pool()`, so launching a task doesn't use the general heap).
+ * Also, we need to store the signal that was sent to the task. The signal is changed
+ * only with compare-and-swap, so no mutex is needed, and the data is shared by the
+ * `AsyncTask` that started it and the running copy, the last one frees it
 */
 struct _TaskData{
-    TaskHandle_t _handle;
-    _TaskSignal _signal;
-    SemaphoreHandle_t _mutex;
+    // FreeRTOS task running the task, set by the task when it starts, cleared when it's
+    // done, NULL before and after, and on an executor
+    std::atomic<TaskHandle_t> _handle;
+    std::atomic<_TaskSignal> _signal;
+    std::atomic<uint8_t> _refs;
+    // stack size the FreeRTOS task was created with, for `StackProfile`
+    uint32_t _stackSize;
 
     _TaskData(TaskHandle_t handle = NULL, _TaskSignal signal = _TaskSignal::RUN):
-        _handle(handle), _signal(signal), _mutex(xSemaphoreCreateMutex()) {}
-    ~_TaskData(){
-        if (_mutex){
-            vSemaphoreDelete(_mutex);
+        _handle(handle), _signal(signal), _refs(1), _stackSize(0) {}
+
+    /**
+     * @brief Change the signal from `from` to `to`, if no one changed it in the meantime
+     * @return true if the signal was changed
+    */
+    bool _transition(_TaskSignal from, _TaskSignal to){
+        return _signal.compare_exchange_strong(from, to);
+    }
+
+    /**
+     * @brief Mark the task as done, called by the running task after the task function,
+     * waits while the task is being paused
+    */
+    void _finish();
+
+    void _acquire(){
+        _refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Drop one reference, the last one returns the data to the pool
+    */
+    void _release(){
+        if (_refs.fetch_sub(1, std::memory_order_acq_rel) == 1){
+            _pool().destroy(this);
         }
     }
+
+    /**
+     * @brief Pool of the task data used by `AsyncTask::run()`
+    */
+    static ObjectPool<_TaskData>& _pool();
+
+    /**
+     * @brief Set the data of the task running on the current thread, returns the previous one
+    */
+    static _TaskData* _swapCurrent(_TaskData* data);
+
+    /**
+     * @brief Data of the task running on the current thread, nullptr outside of a task
+    */
+    static _TaskData* _current();
 };
 
 
@@ -128,22 +258,7 @@ class AsyncTask;
  * and returns the handle
 */
 template <typename... _ArgTypes>
-TaskHandle_t _deleteTask(AsyncTask<_ArgTypes...>* p, bool kill){
-    TaskHandle_t handle = NULL;
-
-    if (p->_data){
-        handle = p->_data->_handle;
-    }
-
-    delete p->_data;
-    delete p;
-
-    if (handle && kill){
-        vTaskDelete(handle);
-    }
-
-    return handle;
-}
+TaskHandle_t _deleteTask(AsyncTask<_ArgTypes...>* p, bool kill);
 
 /**
  * Base class for AsyncTask, used to store parameters and the task data
@@ -152,15 +267,22 @@ class BaseAsyncTask{
   public:
     BaseAsyncTask(const TaskParams& params): _params(params), _data(nullptr) {}
     BaseAsyncTask(): BaseAsyncTask(TaskParams()) {}
-    virtual ~BaseAsyncTask() = default;
+    virtual ~BaseAsyncTask(){
+        if (_data){
+            _data->_release();
+        }
+    }
 
     /**
-     * @brief Stop the task, this will send a signal to the task to stop it, doesn't work immediately
+     * @brief Stop the task, this will send a signal to the task to stop it, doesn't work immediately.
+     * A task that didn't start yet won't run, a running task should check `stopRequested()`
+     * and return early. A paused task is resumed, so it can return
     */
     void stop();
 
     /**
-     * @brief Pause the task, you can resume the task using `resume()`
+     * @brief Pause the task, you can resume the task using `resume()`,
+     * has no effect on tasks running on an `Executor`, nor before the task started
     */
     void pause();
 
@@ -169,12 +291,56 @@ class BaseAsyncTask{
     */
     void resume();
 
+    /**
+     * @brief Usage of the pool of task data (handle, signal and mutex of a running task),
+     * shared by all the `AsyncTask` types
+    */
+    static PoolStats taskDataStats();
+
+    /**
+     * @brief Check if `stop()` was called on the task running on the current thread,
+     * call it from the task function to stop in the middle of a long job.
+     * Cheap enough to call in a loop, false if called outside of an `AsyncTask`
+    */
+    static bool stopRequested();
+
+    /**
+     * @brief Create a FreeRTOS task, pinned to `params.core` if `params.usePinnedCore`,
+     * on a slot of `params.stacks` if it's set, used internally
+     * @return The handle of the task, NULL if it couldn't be created
+    */
+    static TaskHandle_t _createTask(
+        TaskFunction_t fn, const char* name, uint32_t stackSize, void* param, UBaseType_t priority,
+        const TaskParams& params
+    );
+
+    /**
+     * @brief Delete the current FreeRTOS task, created with `_createTask()`, used internally
+    */
+    static void _exitTask();
+
+    /**
+     * @brief Delete a FreeRTOS task created with `_createTask()`, used internally
+     * @param stacks `TaskParams::stacks` the task was created with
+    */
+    static void _killTask(TaskHandle_t handle, BaseStackPool* stacks);
+
   protected:
     /**
-     * @brief Wrapper for the task function, casts the task, runs it and deletes it
+     * @brief Start the task, either by submitting it to the executor from the parameters,
+     * or by creating a new FreeRTOS task (also if the executor couldn't accept it)
+     * @param wrapper Entry point of the FreeRTOS task
+     * @param jobWrapper Entry point of the executor job
+     * @param task Heap copy of the task, passed to the entry point
+     * @return false if the task couldn't be started (no task or stack left)
     */
-    template <typename _Res, typename... _ArgTypes>
-    static void _taskWrapper(void *param){
+    bool _launch(TaskFunction_t wrapper, _JobFunction jobWrapper, void* task);
+
+    /**
+     * @brief Runs the heap copy of the task on the current FreeRTOS task and deletes it
+    */
+    template <typename... _ArgTypes>
+    static void _runAndDelete(void *param){
         // Get the task from the parameter and cast it to the correct type.
         // This is probably the only way to do this, since we can't use lambdas
         // as task functions, and we can't use static_cast with lambdas.
@@ -186,38 +352,78 @@ class BaseAsyncTask{
             return;
         }
 
-        // First, check if the task was stopped, using a mutex
-        if (xSemaphoreTake(task->_data->_mutex, portMAX_DELAY) == pdTRUE){
-            // Must store the mutex in a local variable, since the task can be deleted
-            SemaphoreHandle_t mutex = task->_data->_mutex;
-            // If the task was stopped, delete it and return
-            if (task->_data->_signal == _TaskSignal::STOP){
-                TaskHandle_t handle = _deleteTask<_ArgTypes...>(task, false);
-                xSemaphoreGive(mutex);
-                if (handle){
-                    vTaskDelete(handle);
-                }
-                return;
-            }
-            xSemaphoreGive(mutex);
-        }
+        _TaskData* data = task->_data;
 
-        // Run the task on the current thread
-        task->_runTask();
+        // Run the task on the current thread, if it wasn't stopped before it started
+        if (data->_signal.load() != _TaskSignal::STOP){
+            _TaskData* previous = _TaskData::_swapCurrent(data);
+            task->_runTask();
+            _TaskData::_swapCurrent(previous);
+        }
+        data->_finish();
         
-        // Delete the task after it's done, must be called after the task is done,
-        // also terminates the FreeRTOS task
-        _deleteTask<_ArgTypes...>(task, true);
+        // Delete the task after it's done, the FreeRTOS task is left running,
+        // the caller decides what to do with it
+        _deleteTask<_ArgTypes...>(task, false);
+    }
+
+    /**
+     * @brief Wrapper for the task function, casts the task, runs it, deletes it
+     * and terminates the FreeRTOS task, recording its stack usage
+    */
+    template <typename _Res, typename... _ArgTypes>
+    static void _taskWrapper(void *param){
+        // the task and its data may be gone after it ran
+        AsyncTask<_ArgTypes...>* task = static_cast<AsyncTask<_ArgTypes...>*>(param);
+        uint32_t stackSize = 0;
+        if (task && task->_data){
+            stackSize = task->_data->_stackSize;
+            // published here, not by `_launch()`: a short task may be done (and its
+            // handle deleted) before `_createTask()` returns there
+            task->_data->_handle.store(xTaskGetCurrentTaskHandle());
+        }
+        _runAndDelete<_ArgTypes...>(param);
+        StackProfile::_recordCurrent(stackSize);
+        _exitTask();
+    }
+
+    /**
+     * @brief Wrapper for the task function when it runs on an `Executor`,
+     * the executor's task keeps running after the job is done
+    */
+    template <typename... _ArgTypes>
+    static void _jobWrapper(void *param){
+        _runAndDelete<_ArgTypes...>(param);
     }
 
     template <typename... _ArgTypes>
     friend TaskHandle_t _deleteTask(AsyncTask<_ArgTypes...>* p, bool kill);
     friend class Scheduler;
+    friend class ShardedScheduler;
 
     _TaskData *_data;
     TaskParams _params;
 };
 
+template <typename... _ArgTypes>
+TaskHandle_t _deleteTask(AsyncTask<_ArgTypes...>* p, bool kill){
+    TaskHandle_t handle = NULL;
+    BaseStackPool* stacks = p->_params.stacks;
+
+    if (p->_data){
+        handle = p->_data->_handle.load();
+    }
+
+    // drops the copy's reference to the task data
+    AsyncTask<_ArgTypes...>::_pool().destroy(p);
+
+    if (handle && kill){
+        BaseAsyncTask::_killTask(handle, stacks);
+    }
+
+    return handle;
+}
+
 
 /**
  * ## AsyncTask
@@ -229,12 +435,25 @@ class BaseAsyncTask{
 template <typename... _ArgTypes>
 class AsyncTask : public BaseAsyncTask{
 
-    using _TaskType = std::function<void(_ArgTypes...)>;
+    using _TaskType = InplaceFunction<void(_ArgTypes...)>;
 
     _TaskType _task;
     std::tuple<_ArgTypes...> _args;
 
+    // calls the task function with the arguments moved out of `_args`, passed
+    // as rvalue references all the way down, see `InplaceFunction::_invoke()`
+    struct _Invoker{
+        const _TaskType& task;
+
+        void operator()(_ArgTypes&&... args) const{
+            task._invoke(std::forward<_ArgTypes>(args)...);
+        }
+    };
+
 public:
+    // tag of the constructor building the running copy with its arguments, see `_release()`
+    struct _WithArgs{};
+
     AsyncTask() = default;
     AsyncTask(_TaskType task);
     AsyncTask(const TaskParams& params);
@@ -242,7 +461,25 @@ public:
       const TaskParams& params, 
       _TaskType task
     );
+    /**
+     * @brief Copy the parameters and the task function, the function is always
+     * copyable, a move-only callable fails to compile (see `InplaceFunction`)
+    */
     AsyncTask(const AsyncTask& other);
+    /**
+     * @brief Move the parameters and the task function, without copying the
+     * captures, the running task (if any) stays with `other`
+    */
+    AsyncTask(AsyncTask&& other):
+        BaseAsyncTask(other._params), _task(std::move(other._task)), _args(std::move(other._args)) {}
+
+    /**
+     * @brief Construct the running copy, the arguments are forwarded straight into `_args`,
+     * used internally by `_release()`
+    */
+    template <typename... _Args>
+    AsyncTask(_WithArgs, const TaskParams& params, _TaskType&& task, _Args&&... args):
+        BaseAsyncTask(params), _task(std::move(task)), _args(std::forward<_Args>(args)...) {}
 
     inline AsyncTask& setParams(const TaskParams& params){
         _params = params;
@@ -250,48 +487,63 @@ public:
     }
 
     inline AsyncTask& setTask(_TaskType task){
-        _task = task;
+        _task = std::move(task);
         return *this;
     }
 
     /**
-     * @brief Run the task in the background
+     * @brief Run the task in the background, the task function is moved
+     * to the running task, so this object can't be run again.
+     * The arguments are forwarded into the pool slot of the running task (an rvalue is
+     * moved, an lvalue copied once) and moved from there into the task function,
+     * so move-only types like `std::unique_ptr` can be passed
+     * @return true if the task was started, false if it's already running, has no
+     * task function, or is out of pool slots or stacks (static mode)
     */
-    inline void run(_ArgTypes... args){
+    template <typename... _Args>
+    inline bool run(_Args&&... args){
+        static_assert(sizeof...(_Args) == sizeof...(_ArgTypes),
+            "AsyncTask::run() takes one argument for every argument type of the task");
+
         // If the task is already running, don't run it again
         if (_data){
-            return;
+            return false;
         }
-        _args = std::make_tuple(args...);
         if (_task){
-            _data = new _TaskData();
-            if (_params.usePinnedCore){
-                xTaskCreatePinnedToCore(
-                    _taskWrapper<void, _ArgTypes...>, _params.name.c_str(), _params.stackSize,
-                    copy(), _params.priority, &_data->_handle, _params.core
-                );
-                return;
+            _data = _TaskData::_pool().create();
+            AsyncTask* task = _data ? _release(std::forward<_Args>(args)...) : nullptr;
+            if (task && _launch(_taskWrapper<void, _ArgTypes...>, _jobWrapper<_ArgTypes...>, task)){
+                return true;
+            }
+            // out of pool slots or stacks (static mode), keep the task so it can be run again,
+            // the arguments are dropped if they were already moved into the copy
+            if (task){
+                _task = std::move(task->_task);
+                _deleteTask<_ArgTypes...>(task, false);
+            }
+            if (_data){
+                _data->_release();
+                _data = nullptr;
             }
-            xTaskCreate(
-                _taskWrapper<void, _ArgTypes...>, _params.name.c_str(), _params.stackSize,
-                copy(), _params.priority, &_data->_handle
-            );
         }
+        return false;
     }
     
     /**
      * @brief Same as `run(...)`, but with operator overloading
     */
-    inline void operator()(_ArgTypes... args){
-        run(args...);
+    template <typename... _Args>
+    inline void operator()(_Args&&... args){
+        run(std::forward<_Args>(args)...);
     }
 
     /**
-     * @brief Run the task in the current thread, used internally
+     * @brief Run the task in the current thread, used internally. The arguments
+     * are moved into the task function, so a copy is run only once
     */
     inline void _runTask(){
       if (_task){
-          apply(_task, _args);
+          apply(_Invoker{_task}, std::move(_args));
       }
     }
 
@@ -302,19 +554,66 @@ public:
         return *this;
     }
 
+    AsyncTask& operator=(AsyncTask&& other){
+        _params = other._params;
+        _task = std::move(other._task);
+        _args = std::move(other._args);
+        return *this;
+    }
+
     /**
      * @brief Copy the task to the heap, used internally
     */
     AsyncTask* copy() const{
-        auto ptr = new AsyncTask(*this);
+        auto ptr = _pool().create(*this);
+        if (!ptr){
+            return nullptr;
+        }
+        ptr->_data = _data;
+        if (_data){
+            _data->_acquire();
+        }
+        return ptr;
+    }
+
+    /**
+     * @brief Move the task to the heap, used internally by `run()`, unlike `copy()`
+     * the task function is moved, and the arguments are constructed in the pool slot
+     * from `args`, left untouched if the pool is full
+    */
+    template <typename... _Args>
+    AsyncTask* _release(_Args&&... args){
+        auto ptr = _pool().create(_WithArgs(), _params, std::move(_task), std::forward<_Args>(args)...);
+        if (!ptr){
+            return nullptr;
+        }
         ptr->_data = _data;
+        if (_data){
+            _data->_acquire();
+        }
         return ptr;
     }
+
+    /**
+     * @brief Pool of the copies made by `run()`, used internally,
+     * every `AsyncTask` type has its own pool
+    */
+    static ObjectPool<AsyncTask>& _pool(){
+        static ObjectPool<AsyncTask> pool;
+        return pool;
+    }
+
+    /**
+     * @brief Usage of the pool of the copies made by `run()`, for this `AsyncTask` type
+    */
+    static PoolStats poolStats(){
+        return _pool().stats();
+    }
 };
 
 template <typename... _ArgTypes>
 AsyncTask<_ArgTypes...>::AsyncTask(_TaskType task): 
-    AsyncTask(TaskParams(), task) {}
+    AsyncTask(TaskParams(), std::move(task)) {}
 
 template <typename... _ArgTypes>
 AsyncTask<_ArgTypes...>::AsyncTask(const TaskParams& params) : 
@@ -324,12 +623,11 @@ template <typename... _ArgTypes>
 AsyncTask<_ArgTypes...>::AsyncTask(
   const TaskParams& params, 
   _TaskType task
-) : BaseAsyncTask(params), _task(task) {}
+) : BaseAsyncTask(params), _task(std::move(task)) {}
 
 template <typename... _ArgTypes>
-AsyncTask<_ArgTypes...>::AsyncTask(const AsyncTask& other){
-    *this = other;
-}
+AsyncTask<_ArgTypes...>::AsyncTask(const AsyncTask& other):
+    BaseAsyncTask(other._params), _task(other._task), _args(other._args) {}
 
 /**
  * ## AsyncTask
@@ -341,24 +639,38 @@ AsyncTask<_ArgTypes...>::AsyncTask(const AsyncTask& other){
 template <>
 class AsyncTask<> : public BaseAsyncTask{
 
-    using _TaskType = std::function<void()>;
+    using _TaskType = InplaceFunction<void()>;
 
     _TaskType _task;
 
+    friend class Scheduler;
+
 public:
     AsyncTask();
     AsyncTask(_TaskType task);
     AsyncTask(const TaskParams& params);
     AsyncTask(const TaskParams& params, _TaskType task);
+    /**
+     * @brief Copy the parameters and the task function, the function is always
+     * copyable, a move-only callable fails to compile (see `InplaceFunction`)
+    */
     AsyncTask(const AsyncTask& other);
+    /**
+     * @brief Move the parameters and the task function, without copying the
+     * captures, the running task (if any) stays with `other`
+    */
+    AsyncTask(AsyncTask&& other);
 
     AsyncTask& setParams(const TaskParams& params);
     AsyncTask& setTask(_TaskType task);
 
     /**
-     * @brief Run the task in the background
+     * @brief Run the task in the background, the task function is moved
+     * to the running task, so this object can't be run again
+     * @return true if the task was started, false if it's already running, has no
+     * task function, or is out of pool slots or stacks (static mode)
     */
-    void run();
+    bool run();
 
     /**
      * @brief Same as `run()`, but with operator overloading
@@ -371,11 +683,28 @@ public:
     void _runTask();    
 
     AsyncTask& operator=(const AsyncTask& other);
+    AsyncTask& operator=(AsyncTask&& other);
 
     /**
      * @brief Copy the task to the heap, used internally
     */
     AsyncTask* copy() const;
+
+    /**
+     * @brief Move the task to the heap, used internally by `run()`,
+     * unlike `copy()` the task function is moved, not copied
+    */
+    AsyncTask* _release();
+
+    /**
+     * @brief Pool of the copies made by `run()`, used internally
+    */
+    static ObjectPool<AsyncTask>& _pool();
+
+    /**
+     * @brief Usage of the pool of the copies made by `run()`, for `AsyncTask<>`
+    */
+    static PoolStats poolStats();
 };
 
 
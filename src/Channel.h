@@ -0,0 +1,438 @@
+#pragma once
+
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "port.h"
+#include "namespaces.h"
+#include "waiters.h"
+
+// padding between the sender and receiver counters of a `Channel`, so they don't share a cache line
+#ifndef ASYNC_TASKS_CACHE_LINE
+#   define ASYNC_TASKS_CACHE_LINE 64
+#endif
+
+BEGIN_TASKS_NAMESPACE
+
+/**
+ * Who uses a `Channel`
+*/
+enum class ChannelMode{
+    // any number of sending and receiving tasks, every send and receive is one compare-and-swap
+    Mpmc,
+    // one sending task (or interrupt handler) and one receiving task, no compare-and-swap at all
+    Spsc,
+};
+
+/**
+ * Ring buffer with one producer and one consumer. Each side owns its counter and keeps
+ * a cached copy of the other one, so it only reads the other side's cache line when
+ * the ring looks full (or empty)
+*/
+template <typename _Tp, size_t _Size>
+class _SpscRing{
+    typedef typename std::aligned_storage<sizeof(_Tp), alignof(_Tp)>::type _Slot;
+
+    _Slot _slots[_Size];
+    char _padSlots[ASYNC_TASKS_CACHE_LINE];
+
+    // consumer side
+    std::atomic<uint32_t> _head;
+    uint32_t _tailSeen;
+    char _padHead[ASYNC_TASKS_CACHE_LINE];
+
+    // producer side
+    std::atomic<uint32_t> _tail;
+    uint32_t _headSeen;
+    char _padTail[ASYNC_TASKS_CACHE_LINE];
+
+    _Tp* _at(uint32_t pos){
+        return reinterpret_cast<_Tp*>(&_slots[pos & (_Size - 1)]);
+    }
+
+  public:
+    _SpscRing(): _head(0), _tailSeen(0), _tail(0), _headSeen(0) {}
+
+    ~_SpscRing(){
+        uint32_t tail = _tail.load(std::memory_order_acquire);
+        for (uint32_t pos = _head.load(std::memory_order_relaxed); pos != tail; pos++){
+            _at(pos)->~_Tp();
+        }
+    }
+
+    template <typename _Up>
+    bool push(_Up&& item){
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _headSeen == _Size){
+            _headSeen = _head.load(std::memory_order_acquire);
+            if (tail - _headSeen == _Size){
+                return false;
+            }
+        }
+        new (_at(tail)) _Tp(std::forward<_Up>(item));
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    size_t popMany(_Tp* items, size_t max){
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        if (_tailSeen - head < max){
+            _tailSeen = _tail.load(std::memory_order_acquire);
+        }
+        size_t count = _tailSeen - head < max ? _tailSeen - head : max;
+        for (size_t i = 0; i < count; i++){
+            _Tp* slot = _at(head + uint32_t(i));
+            items[i] = std::move(*slot);
+            slot->~_Tp();
+        }
+        if (count){
+            _head.store(head + uint32_t(count), std::memory_order_release);
+        }
+        return count;
+    }
+
+    size_t size() const{
+        return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+    }
+};
+
+/**
+ * Ring buffer with any number of producers and consumers, every cell has a sequence
+ * number that tells whose turn it is (see `_MpmcQueue`), the items are stored in place
+*/
+template <typename _Tp, size_t _Size>
+class _MpmcRing{
+    struct _Cell{
+        std::atomic<uint32_t> sequence;
+        typename std::aligned_storage<sizeof(_Tp), alignof(_Tp)>::type data;
+    };
+
+    _Cell _cells[_Size];
+    char _padCells[ASYNC_TASKS_CACHE_LINE];
+    std::atomic<uint32_t> _head;
+    char _padHead[ASYNC_TASKS_CACHE_LINE];
+    std::atomic<uint32_t> _tail;
+    char _padTail[ASYNC_TASKS_CACHE_LINE];
+
+  public:
+    _MpmcRing(): _head(0), _tail(0){
+        for (uint32_t i = 0; i < _Size; i++){
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~_MpmcRing(){
+        uint32_t tail = _tail.load(std::memory_order_acquire);
+        for (uint32_t pos = _head.load(std::memory_order_relaxed); pos != tail; pos++){
+            _Cell& cell = _cells[pos & (_Size - 1)];
+            if (cell.sequence.load(std::memory_order_acquire) == pos + 1){
+                reinterpret_cast<_Tp*>(&cell.data)->~_Tp();
+            }
+        }
+    }
+
+    template <typename _Up>
+    bool push(_Up&& item){
+        uint32_t pos = _tail.load(std::memory_order_relaxed);
+        for (;;){
+            _Cell& cell = _cells[pos & (_Size - 1)];
+            uint32_t seq = cell.sequence.load(std::memory_order_acquire);
+            int32_t diff = int32_t(seq - pos);
+            if (diff == 0){
+                if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                    new (&cell.data) _Tp(std::forward<_Up>(item));
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0){
+                return false;
+            } else {
+                pos = _tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool pop(_Tp& item){
+        uint32_t pos = _head.load(std::memory_order_relaxed);
+        for (;;){
+            _Cell& cell = _cells[pos & (_Size - 1)];
+            uint32_t seq = cell.sequence.load(std::memory_order_acquire);
+            int32_t diff = int32_t(seq - (pos + 1));
+            if (diff == 0){
+                if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                    _Tp* data = reinterpret_cast<_Tp*>(&cell.data);
+                    item = std::move(*data);
+                    data->~_Tp();
+                    cell.sequence.store(pos + _Size, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0){
+                return false;
+            } else {
+                pos = _head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    size_t popMany(_Tp* items, size_t max){
+        size_t count = 0;
+        while (count < max && pop(items[count])){
+            count++;
+        }
+        return count;
+    }
+
+    size_t size() const{
+        int32_t size = int32_t(_tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire));
+        return size > 0 ? size_t(size) : 0;
+    }
+};
+
+/*
+
+## Channel
+
+A bounded queue of `_Size` items of type `_Tp` (a power of 2), to hand data from one
+task to another, for example between the stages of a pipeline.
+
+The items are stored in a ring buffer inside the channel, they are moved in on send
+and moved out on receive, move-only types are fine. Sending and receiving never take
+a lock, and a task blocked on a full or empty channel is woken with its task notification,
+only when it is actually blocked, so a busy channel doesn't make a kernel call per item.
+`recvMany()` takes up to `max` items with one wake-up.
+
+After `close()` sends fail, receives return the items left and then fail, and all the
+blocked tasks are woken up.
+
+With `ChannelMode::Spsc`, only one task (or interrupt handler) may send, and only one
+task may receive, in exchange sending and receiving need no compare-and-swap.
+
+Blocking uses the task notification of the blocked task (the one with index 0), don't
+block on a channel in a task that uses notifications for something else.
+
+### Example
+
+```cpp
+Channel<Sample, 64, ChannelMode::Spsc> samples;
+
+AsyncTask<> filter([]() {
+  Sample batch[16];
+  size_t count;
+  while ((count = samples.recvMany(batch, 16)) > 0) {
+    process(batch, count);
+  }
+});
+filter.run();
+
+samples.send(readAdc());
+// ...
+samples.close(); // the filter task returns once it took the remaining samples
+```
+
+*/
+template <typename _Tp, size_t _Size, ChannelMode _Mode = ChannelMode::Mpmc>
+class Channel{
+    static_assert(_Size >= 2 && (_Size & (_Size - 1)) == 0, "Channel size must be a power of 2");
+
+    typename std::conditional<_Mode == ChannelMode::Spsc, _SpscRing<_Tp, _Size>, _MpmcRing<_Tp, _Size>>::type _ring;
+    std::atomic<bool> _closed;
+    _TaskWaiters _senders;
+    _TaskWaiters _receivers;
+
+    /**
+     * @brief Call `attempt` until it succeeds, blocking on `waiters` in between
+     * @return false if the channel was closed (before an attempt that failed) or `ticks` passed
+    */
+    template <typename _Attempt>
+    bool _retry(_TaskWaiters& waiters, TickType_t ticks, _Attempt attempt){
+        TickType_t start = xTaskGetTickCount();
+        for (;;){
+            bool closed = _closed.load(std::memory_order_acquire);
+            if (attempt()){
+                return true;
+            }
+            if (closed){
+                return false;
+            }
+
+            TickType_t timeout = portMAX_DELAY;
+            if (ticks != portMAX_DELAY){
+                TickType_t elapsed = xTaskGetTickCount() - start;
+                if (elapsed >= ticks){
+                    return false;
+                }
+                timeout = ticks - elapsed;
+            }
+
+            int slot = waiters._add();
+            // a change between the attempt and `_add()` didn't wake us up, check again
+            closed = _closed.load(std::memory_order_acquire);
+            bool done = !closed && attempt();
+            if (closed || done){
+                waiters._remove(slot, false);
+                if (done){
+                    return true;
+                }
+                // closed, the next attempt is the last one
+                continue;
+            }
+            waiters._sleep(slot, timeout);
+        }
+    }
+
+    template <typename _Up>
+    bool _send(_Up&& item, TickType_t ticks){
+        return _retry(_senders, ticks, [&](){
+            return trySend(std::forward<_Up>(item));
+        });
+    }
+
+    size_t _recvMany(_Tp* items, size_t max, TickType_t ticks){
+        size_t count = 0;
+        _retry(_receivers, ticks, [&](){
+            count = tryRecvMany(items, max);
+            return count > 0;
+        });
+        return count;
+    }
+
+  public:
+    Channel(): _ring(), _closed(false), _senders(), _receivers() {}
+
+    Channel(const Channel&) = delete;
+    Channel& operator=(const Channel&) = delete;
+
+    /**
+     * @brief Send an item, blocks while the channel is full
+     * @return false if the channel is closed, the item is left untouched then
+    */
+    template <typename _Up>
+    bool send(_Up&& item){
+        return _send(std::forward<_Up>(item), portMAX_DELAY);
+    }
+
+    /**
+     * @brief Send an item, blocks while the channel is full, up to `timeout` milliseconds
+     * @return false if the channel is closed or still full, the item is left untouched then
+    */
+    template <typename _Up>
+    bool sendFor(_Up&& item, uint32_t timeout){
+        return _send(std::forward<_Up>(item), pdMS_TO_TICKS(timeout));
+    }
+
+    /**
+     * @brief Send an item if there is room, doesn't block
+     * @return false if the channel is closed or full, the item is left untouched then
+    */
+    template <typename _Up>
+    bool trySend(_Up&& item){
+        if (_closed.load(std::memory_order_acquire) || !_ring.push(std::forward<_Up>(item))){
+            return false;
+        }
+        _receivers._wakeOne();
+        return true;
+    }
+
+    /**
+     * @brief Send an item from an interrupt handler, doesn't block. If it wakes up a task
+     * with a higher priority than the interrupted one, the context switch happens right
+     * when the handler returns
+     * @return false if the channel is closed or full
+    */
+    template <typename _Up>
+    bool trySendFromISR(_Up&& item){
+        if (_closed.load(std::memory_order_acquire) || !_ring.push(std::forward<_Up>(item))){
+            return false;
+        }
+        BaseType_t woken = pdFALSE;
+        _receivers._wakeOneFromISR(&woken);
+        portYIELD_FROM_ISR(woken);
+        return true;
+    }
+
+    /**
+     * @brief Receive the oldest item, blocks while the channel is empty
+     * @return false if the channel is closed and empty
+    */
+    bool recv(_Tp& item){
+        return _recvMany(&item, 1, portMAX_DELAY) == 1;
+    }
+
+    /**
+     * @brief Receive the oldest item, blocks while the channel is empty, up to `timeout` milliseconds
+     * @return false if the channel is closed and empty, or still empty
+    */
+    bool recvFor(_Tp& item, uint32_t timeout){
+        return _recvMany(&item, 1, pdMS_TO_TICKS(timeout)) == 1;
+    }
+
+    /**
+     * @brief Receive the oldest item if there is one, doesn't block
+     * @return false if the channel is empty
+    */
+    bool tryRecv(_Tp& item){
+        return tryRecvMany(&item, 1) == 1;
+    }
+
+    /**
+     * @brief Receive up to `max` items, oldest first, blocks while the channel is empty
+     * and then takes all the items there are, without blocking again
+     * @return Number of items stored in `items`, 0 if the channel is closed and empty
+    */
+    size_t recvMany(_Tp* items, size_t max){
+        return _recvMany(items, max, portMAX_DELAY);
+    }
+
+    /**
+     * @brief Same as `recvMany()`, blocks up to `timeout` milliseconds
+     * @return Number of items stored in `items`, 0 if the channel is closed and empty, or still empty
+    */
+    size_t recvManyFor(_Tp* items, size_t max, uint32_t timeout){
+        return _recvMany(items, max, pdMS_TO_TICKS(timeout));
+    }
+
+    /**
+     * @brief Receive up to `max` items, oldest first, doesn't block
+     * @return Number of items stored in `items`
+    */
+    size_t tryRecvMany(_Tp* items, size_t max){
+        size_t count = max ? _ring.popMany(items, max) : 0;
+        for (size_t i = 0; i < count && _senders._wakeOne(); i++) {}
+        return count;
+    }
+
+    /**
+     * @brief Close the channel: sends fail from now on, receives take the items left,
+     * and the blocked tasks are woken up. A send running at the same time may still succeed
+    */
+    void close(){
+        _closed.store(true, std::memory_order_release);
+        _senders._wakeAll();
+        _receivers._wakeAll();
+    }
+
+    bool closed() const{
+        return _closed.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Number of items in the channel, might be outdated right after the call
+    */
+    size_t size() const{
+        return _ring.size();
+    }
+
+    bool empty() const{
+        return size() == 0;
+    }
+
+    static constexpr size_t capacity(){
+        return _Size;
+    }
+};
+
+END_TASKS_NAMESPACE
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "namespaces.h"
+
+BEGIN_TASKS_NAMESPACE
+
+// Function executed by an `Executor`, receives the argument given to `submit`
+using _JobFunction = void (*)(void*);
+
+/**
+ * ## Executor
+ *
+ * Base class for objects that run jobs on already existing, long-lived FreeRTOS tasks,
+ * instead of creating a new task for every `AsyncTask::run()`.
+ *
+ * Set it with `TaskParams::setExecutor(...)` or `Scheduler::setExecutor(...)`.
+*/
+class Executor{
+  public:
+    virtual ~Executor() = default;
+
+    /**
+     * @brief Submit a job, that will be executed on one of the executor's tasks
+     * @param fn The function to be called
+     * @param arg The argument passed to `fn`
+     * @return true if the job was accepted, false if it couldn't be queued
+    */
+    virtual bool submit(_JobFunction fn, void* arg) = 0;
+
+    /**
+     * @brief Submit a job from an interrupt handler, doesn't block and doesn't allocate.
+     * If the job wakes up a task with a higher priority than the interrupted one,
+     * the context switch happens right when the handler returns (`portYIELD_FROM_ISR`)
+     * @return true if the job was accepted, false if it couldn't be queued,
+     * or the executor doesn't support submitting from interrupts
+    */
+    virtual bool submitFromISR(_JobFunction fn, void* arg){
+      (void)fn;
+      (void)arg;
+      return false;
+    }
+};
+
+END_TASKS_NAMESPACE
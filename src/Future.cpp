@@ -0,0 +1,45 @@
+#include "Future.h"
+
+BEGIN_TASKS_NAMESPACE
+
+void _FutureStateBase::_complete(){
+    _ready.store(true);
+    // Whoever takes the waiter out of the state sends the notification, so it's sent at most once
+    TaskHandle_t waiter = _waiter.exchange(NULL);
+    if (waiter){
+        xTaskNotifyGive(waiter);
+    }
+}
+
+bool _FutureStateBase::_wait(TickType_t ticks){
+    if (_ready.load(std::memory_order_acquire)){
+        return true;
+    }
+
+    _waiter.store(xTaskGetCurrentTaskHandle());
+
+    TickType_t start = xTaskGetTickCount();
+    bool notified = false;
+    while (!_ready.load()){
+        TickType_t timeout = portMAX_DELAY;
+        if (ticks != portMAX_DELAY){
+            TickType_t elapsed = xTaskGetTickCount() - start;
+            if (elapsed >= ticks){
+                break;
+            }
+            timeout = ticks - elapsed;
+        }
+        if (ulTaskNotifyTake(pdTRUE, timeout) && _ready.load()){
+            notified = true;
+        }
+    }
+
+    // If the completer already took the waiter out, its notification is sent or about
+    // to be, consume it, so it doesn't wake up a later, unrelated wait of this task
+    if (!notified && _waiter.exchange(NULL) == NULL){
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+    return _ready.load(std::memory_order_acquire);
+}
+
+END_TASKS_NAMESPACE
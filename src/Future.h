@@ -0,0 +1,304 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "./AsyncTask.h"
+#include "./Executor.h"
+#include "./object_pool.h"
+#include "./tuple.h"
+
+BEGIN_TASKS_NAMESPACE
+
+/**
+ * Shared state of a `Future`, the part that doesn't depend on the result type.
+ *
+ * Completion is an atomic flag, a waiting task registers its handle and is woken
+ * with a direct-to-task notification right when the result is set, so there is
+ * no polling and no kernel object per future.
+*/
+class _FutureStateBase{
+  public:
+    // set once the result is stored
+    std::atomic<bool> _ready;
+    // the task blocked in `_wait()`, if any
+    std::atomic<TaskHandle_t> _waiter;
+    // one reference for the `Future`, one for the running job
+    std::atomic<uint8_t> _refs;
+    // destroys the full object and returns it to its pool
+    void (*_destroy)(_FutureStateBase*);
+
+    explicit _FutureStateBase(void (*destroy)(_FutureStateBase*)):
+        _ready(false), _waiter(NULL), _refs(2), _destroy(destroy) {}
+
+    /**
+     * @brief Mark the result as ready, and wake the waiting task
+    */
+    void _complete();
+
+    /**
+     * @brief Block the current task until the result is ready
+     * @param ticks Maximum time to wait, `portMAX_DELAY` to wait forever
+     * @return true if the result is ready
+    */
+    bool _wait(TickType_t ticks);
+
+    /**
+     * @brief Drop one reference, the last one destroys the state
+    */
+    void _release(){
+        if (_refs.fetch_sub(1, std::memory_order_acq_rel) == 1){
+            _destroy(this);
+        }
+    }
+};
+
+template <typename _Res>
+class _FutureState : public _FutureStateBase{
+    static_assert(!std::is_reference<_Res>::value, "Future doesn't support reference results");
+
+    typename std::aligned_storage<sizeof(_Res), alignof(_Res)>::type _value;
+    bool _hasValue;
+
+  public:
+    explicit _FutureState(void (*destroy)(_FutureStateBase*)):
+        _FutureStateBase(destroy), _hasValue(false) {}
+
+    ~_FutureState(){
+        if (_hasValue){
+            reinterpret_cast<_Res*>(&_value)->~_Res();
+        }
+    }
+
+    template <typename... _ArgTypes>
+    void _set(_ArgTypes&&... args){
+        new (&_value) _Res(std::forward<_ArgTypes>(args)...);
+        _hasValue = true;
+        _complete();
+    }
+
+    _Res _take(){
+        return std::move(*reinterpret_cast<_Res*>(&_value));
+    }
+};
+
+template <>
+class _FutureState<void> : public _FutureStateBase{
+  public:
+    explicit _FutureState(void (*destroy)(_FutureStateBase*)):
+        _FutureStateBase(destroy) {}
+
+    void _take() {}
+};
+
+/**
+ * ## Future
+ *
+ * The result of a job started with `submit(...)`. The result can be taken once,
+ * with `get()`, only one task may wait for it at a time.
+ *
+ * Waiting uses the task notification of the waiting task (the one with index 0),
+ * don't wait for a future on a task that uses notifications for something else.
+*/
+template <typename _Res>
+class Future{
+    _FutureState<_Res>* _state;
+
+  public:
+    Future(): _state(nullptr) {}
+    explicit Future(_FutureState<_Res>* state): _state(state) {}
+
+    Future(const Future&) = delete;
+    Future& operator=(const Future&) = delete;
+
+    Future(Future&& other): _state(other._state){
+        other._state = nullptr;
+    }
+
+    Future& operator=(Future&& other){
+        if (this != &other){
+            if (_state){
+                _state->_release();
+            }
+            _state = other._state;
+            other._state = nullptr;
+        }
+        return *this;
+    }
+
+    ~Future(){
+        if (_state){
+            _state->_release();
+        }
+    }
+
+    /**
+     * @brief Check if the future refers to a job, false if it's default constructed,
+     * moved from, or the job couldn't be started
+    */
+    bool valid() const{
+        return _state != nullptr;
+    }
+
+    /**
+     * @brief Check if the result is ready, doesn't block
+    */
+    bool ready() const{
+        return _state && _state->_ready.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Block until the result is ready
+    */
+    void wait() const{
+        if (_state){
+            _state->_wait(portMAX_DELAY);
+        }
+    }
+
+    /**
+     * @brief Block until the result is ready, or the timeout passes
+     * @param timeout Maximum time to wait in milliseconds
+     * @return true if the result is ready
+    */
+    bool waitFor(uint32_t timeout) const{
+        return _state && _state->_wait(pdMS_TO_TICKS(timeout));
+    }
+
+    /**
+     * @brief Wait for the result and move it out of the future, call only once, the
+     * future isn't `valid()` afterwards. Calling it on a future that isn't `valid()`
+     * fails an assert
+    */
+    _Res get(){
+        assert(_state && "Future::get() on a future without a job, check valid()");
+        wait();
+        // drops the state after the result is moved out
+        struct _Taken{
+            _FutureState<_Res>* state;
+            ~_Taken(){
+                state->_release();
+            }
+        } taken = {_state};
+        _state = nullptr;
+        return taken.state->_take();
+    }
+};
+
+/**
+ * A job started with `submit(...)`: the function, its arguments and the shared
+ * state, all in one slot of a pool, so submitting doesn't use the heap
+*/
+template <typename _Res, typename _Fn, typename... _ArgTypes>
+class _FutureJob : public _FutureState<_Res>{
+
+    template <typename _Tp, typename = void>
+    struct _Invoke{
+        static void run(_FutureJob& job){
+            job._set(async_tasks::apply(job._fn, job._args));
+        }
+    };
+
+    template <typename _Tp>
+    struct _Invoke<_Tp, typename std::enable_if<std::is_void<_Tp>::value>::type>{
+        static void run(_FutureJob& job){
+            async_tasks::apply(job._fn, job._args);
+            job._complete();
+        }
+    };
+
+    static void _destroyJob(_FutureStateBase* state){
+        _pool().destroy(static_cast<_FutureJob*>(state));
+    }
+
+  public:
+    _Fn _fn;
+    std::tuple<_ArgTypes...> _args;
+
+    template <typename _F, typename... _A>
+    _FutureJob(_F&& fn, _A&&... args):
+        _FutureState<_Res>(_destroyJob), _fn(std::forward<_F>(fn)), _args(std::forward<_A>(args)...) {}
+
+    static ObjectPool<_FutureJob>& _pool(){
+        static ObjectPool<_FutureJob> pool;
+        return pool;
+    }
+
+    /**
+     * @brief Run the job, store the result and drop the job's reference
+    */
+    static void _run(void* param){
+        _FutureJob* job = static_cast<_FutureJob*>(param);
+        _Invoke<_Res>::run(*job);
+        job->_release();
+    }
+
+    /**
+     * @brief Entry point of a FreeRTOS task created for the job
+    */
+    static void _taskEntry(void* param){
+        _run(param);
+        BaseAsyncTask::_exitTask();
+    }
+};
+
+// Result type of calling `_Fn` with the stored (lvalue) arguments
+template <typename _Fn, typename... _ArgTypes>
+using _FutureResult = typename std::decay<
+    decltype(std::declval<typename std::decay<_Fn>::type&>()(std::declval<typename std::decay<_ArgTypes>::type&>()...))
+>::type;
+
+template <typename _Fn, typename... _ArgTypes>
+using _FutureJobFor = _FutureJob<
+    _FutureResult<_Fn, _ArgTypes...>,
+    typename std::decay<_Fn>::type,
+    typename std::decay<_ArgTypes>::type...
+>;
+
+/**
+ * @brief Run `fn(args...)` on the executor, and return a `Future` of its result,
+ * falls back to a new FreeRTOS task (default `TaskParams`) if the executor is full
+ * @return The future, invalid if the job couldn't be started at all
+*/
+template <typename _Fn, typename... _ArgTypes>
+Future<_FutureResult<_Fn, _ArgTypes...>> submit(Executor& executor, _Fn&& fn, _ArgTypes&&... args){
+    return submit(TaskParams().setExecutor(&executor), std::forward<_Fn>(fn), std::forward<_ArgTypes>(args)...);
+}
+
+/**
+ * @brief Run `fn(args...)` in the background, on `params.executor` if it's set,
+ * otherwise on a new FreeRTOS task created with `params`
+ * @return A `Future` of the result, invalid if the job couldn't be started
+*/
+template <typename _Fn, typename... _ArgTypes>
+Future<_FutureResult<_Fn, _ArgTypes...>> submit(const TaskParams& params, _Fn&& fn, _ArgTypes&&... args){
+    using _Job = _FutureJobFor<_Fn, _ArgTypes...>;
+    using _Result = _FutureResult<_Fn, _ArgTypes...>;
+
+    _Job* job = _Job::_pool().create(std::forward<_Fn>(fn), std::forward<_ArgTypes>(args)...);
+    if (!job){
+        // the pool is full, in static mode
+        return Future<_Result>();
+    }
+    Future<_Result> future(job);
+
+    if (params.executor && params.executor->submit(_Job::_run, job)){
+        return future;
+    }
+
+    TaskHandle_t created = BaseAsyncTask::_createTask(
+        _Job::_taskEntry, params.name, params.stackSize, job, params.priority, params
+    );
+
+    if (!created){
+        // the job will never run, drop its reference, the future's one is dropped on return
+        job->_release();
+        return Future<_Result>();
+    }
+    return future;
+}
+
+END_TASKS_NAMESPACE
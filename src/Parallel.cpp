@@ -0,0 +1,73 @@
+#include "Parallel.h"
+
+BEGIN_TASKS_NAMESPACE
+
+_ParallelState::_ParallelState(size_t begin, size_t end, size_t grain, _ChunkFunction chunk, void* context):
+    _FutureStateBase(_destroyState), _next(begin), _end(end), _grain(grain),
+    _left(end - begin), _chunk(chunk), _context(context){
+    // the caller's reference, `_parallelRun()` adds one for every helper job
+    _refs.store(1, std::memory_order_relaxed);
+}
+
+void _ParallelState::_destroyState(_FutureStateBase* state){
+    _pool().destroy(static_cast<_ParallelState*>(state));
+}
+
+ObjectPool<_ParallelState>& _ParallelState::_pool(){
+    static ObjectPool<_ParallelState> pool;
+    return pool;
+}
+
+void _ParallelState::_work(){
+    size_t begin = _next.load(std::memory_order_relaxed);
+    for (;;){
+        if (begin >= _end){
+            return;
+        }
+        size_t end = _end - begin > _grain ? begin + _grain : _end;
+        if (!_next.compare_exchange_weak(begin, end, std::memory_order_relaxed)){
+            continue;
+        }
+        _chunk(_context, begin, end);
+        // the last chunk wakes the caller, the body must not be touched after this
+        if (_left.fetch_sub(end - begin, std::memory_order_acq_rel) == end - begin){
+            _complete();
+            return;
+        }
+        begin = _next.load(std::memory_order_relaxed);
+    }
+}
+
+void _ParallelState::_helper(void* param){
+    _ParallelState* state = static_cast<_ParallelState*>(param);
+    state->_work();
+    state->_release();
+}
+
+void _parallelRun(Executor& executor, size_t begin, size_t end, size_t grain, _ChunkFunction chunk, void* context){
+    _ParallelState* state = _ParallelState::_pool().create(begin, end, grain, chunk, context);
+    if (!state){
+        // the pool is full, in static mode
+        for (size_t i = begin; i < end; i += grain){
+            chunk(context, i, end - i > grain ? i + grain : end);
+        }
+        return;
+    }
+
+    // one chunk stays for the caller
+    size_t chunks = (end - begin + grain - 1) / grain;
+    size_t helpers = chunks - 1 < size_t(ASYNC_TASKS_PARALLEL_HELPERS) ? chunks - 1 : size_t(ASYNC_TASKS_PARALLEL_HELPERS);
+    for (size_t i = 0; i < helpers; i++){
+        state->_refs.fetch_add(1, std::memory_order_relaxed);
+        if (!executor.submit(_ParallelState::_helper, state)){
+            state->_refs.fetch_sub(1, std::memory_order_relaxed);
+            break;
+        }
+    }
+
+    state->_work();
+    state->_wait(portMAX_DELAY);
+    state->_release();
+}
+
+END_TASKS_NAMESPACE
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <stddef.h>
+
+#include "./Executor.h"
+#include "./Future.h"
+#include "./object_pool.h"
+
+// jobs submitted to the executor by `parallelFor()` and `parallelReduce()`, to help the
+// calling task, by default one per other core
+#ifndef ASYNC_TASKS_PARALLEL_HELPERS
+#   define ASYNC_TASKS_PARALLEL_HELPERS (portNUM_PROCESSORS - 1)
+#endif
+
+// most chunks `parallelReduce()` splits a range into, the partial results of all
+// of them are kept on the stack of the calling task, the grain is raised to fit
+#ifndef ASYNC_TASKS_PARALLEL_CHUNKS
+#   define ASYNC_TASKS_PARALLEL_CHUNKS 32
+#endif
+
+BEGIN_TASKS_NAMESPACE
+
+// Function running one chunk `[begin, end)` of a parallel loop, `context` is the caller's loop body
+using _ChunkFunction = void (*)(void* context, size_t begin, size_t end);
+
+/**
+ * Shared state of a `parallelFor()`: the next chunk to take, and the items left to finish.
+ * The caller and the helper jobs take chunks with compare-and-swap, the one finishing
+ * the last chunk completes the state, which wakes the caller (see `_FutureStateBase`).
+ *
+ * The state is pooled and counted, the caller returns when all the chunks are done, but
+ * a helper job may start only after that, it finds no chunk left and just drops the state.
+ * So the body (on the caller's stack) is only called while the caller waits
+*/
+class _ParallelState : public _FutureStateBase{
+    std::atomic<size_t> _next;
+    size_t _end;
+    size_t _grain;
+    // items of the range not finished yet
+    std::atomic<size_t> _left;
+    _ChunkFunction _chunk;
+    void* _context;
+
+    static void _destroyState(_FutureStateBase* state);
+
+  public:
+    _ParallelState(size_t begin, size_t end, size_t grain, _ChunkFunction chunk, void* context);
+
+    /**
+     * @brief Take and run chunks until there is none left
+    */
+    void _work();
+
+    /**
+     * @brief Job function of the helpers, runs `_work()` and drops the job's reference
+    */
+    static void _helper(void* param);
+
+    static ObjectPool<_ParallelState>& _pool();
+};
+
+/**
+ * @brief Run `chunk(context, ...)` over `[begin, end)` in chunks of `grain` items, on the
+ * calling task and on up to `ASYNC_TASKS_PARALLEL_HELPERS` jobs of `executor`,
+ * returns when all the chunks are done, used internally
+*/
+void _parallelRun(Executor& executor, size_t begin, size_t end, size_t grain, _ChunkFunction chunk, void* context);
+
+template <typename _Fn>
+void _callChunk(void* context, size_t begin, size_t end){
+    (*static_cast<_Fn*>(context))(begin, end);
+}
+
+/**
+ * @brief Run `fn(chunkBegin, chunkEnd)` over the index range `[begin, end)`, split into
+ * chunks of `grain` indices, on all cores. The calling task runs chunks too, and the idle
+ * workers of `executor` (a `WorkStealingExecutor`, with one worker per core) take the
+ * rest, `parallelFor()` returns when they are all done.
+ *
+ * A range of up to `grain` indices runs right away on the calling task, without touching
+ * the executor, so pick `grain` as the smallest chunk worth handing to another core.
+ * If the executor is full, the calling task runs the whole range.
+ *
+ * `fn` is called from several tasks at the same time, with chunks that don't overlap.
+ * The calling task waits with its task notification, like `Future::wait()`
+ *
+ * ### Example
+ *
+ * ```cpp
+ * parallelFor(executor, 0, samples, 256, [&](size_t begin, size_t end) {
+ *   for (size_t i = begin; i < end; i++) {
+ *     output[i] = fir(input, i);
+ *   }
+ * });
+ * ```
+*/
+template <typename _Fn>
+void parallelFor(Executor& executor, size_t begin, size_t end, size_t grain, _Fn&& fn){
+    typedef typename std::remove_reference<_Fn>::type _Body;
+
+    if (begin >= end){
+        return;
+    }
+    if (grain == 0){
+        grain = 1;
+    }
+    if (end - begin <= grain){
+        fn(begin, end);
+        return;
+    }
+    _parallelRun(executor, begin, end, grain, _callChunk<_Body>, const_cast<void*>(static_cast<const void*>(&fn)));
+}
+
+/**
+ * Loop body of a `parallelReduce()`, stores the result of every chunk at its index,
+ * so they are combined in the order of the range
+*/
+template <typename _Tp, typename _Fn>
+struct _ReduceBody{
+    typedef typename std::aligned_storage<sizeof(_Tp), alignof(_Tp)>::type _Slot;
+
+    _Fn& fn;
+    size_t begin;
+    size_t grain;
+    _Slot partials[ASYNC_TASKS_PARALLEL_CHUNKS];
+
+    _ReduceBody(_Fn& fn, size_t begin, size_t grain): fn(fn), begin(begin), grain(grain) {}
+
+    void operator()(size_t chunkBegin, size_t chunkEnd){
+        new (&partials[(chunkBegin - begin) / grain]) _Tp(fn(chunkBegin, chunkEnd));
+    }
+
+    _Tp* partial(size_t index){
+        return reinterpret_cast<_Tp*>(&partials[index]);
+    }
+};
+
+/**
+ * @brief Reduce the index range `[begin, end)` on all cores: `fn(chunkBegin, chunkEnd)`
+ * returns the result of a chunk of `grain` indices, and the results are folded with
+ * `combine(a, b)`, starting from `identity`. Runs like `parallelFor()`, a range of up
+ * to `grain` indices runs right away on the calling task.
+ *
+ * The chunk results are combined on the calling task, in the order of the range, so
+ * the result is the same on every run, also for floating point sums. The range is
+ * split into at most `ASYNC_TASKS_PARALLEL_CHUNKS` chunks, the grain is raised to fit
+ *
+ * ### Example
+ *
+ * ```cpp
+ * float energy = parallelReduce(executor, 0, samples, 256, 0.0f,
+ *   [&](size_t begin, size_t end) {
+ *     float sum = 0;
+ *     for (size_t i = begin; i < end; i++) {
+ *       sum += input[i] * input[i];
+ *     }
+ *     return sum;
+ *   },
+ *   [](float a, float b) { return a + b; });
+ * ```
+*/
+template <typename _Tp, typename _Fn, typename _Combine>
+_Tp parallelReduce(Executor& executor, size_t begin, size_t end, size_t grain, _Tp identity, _Fn&& fn, _Combine&& combine){
+    typedef typename std::remove_reference<_Fn>::type _Body;
+
+    if (begin >= end){
+        return identity;
+    }
+    size_t count = end - begin;
+    if (grain == 0){
+        grain = 1;
+    }
+    if (count <= grain){
+        return combine(std::move(identity), fn(begin, end));
+    }
+    size_t minGrain = (count + ASYNC_TASKS_PARALLEL_CHUNKS - 1) / ASYNC_TASKS_PARALLEL_CHUNKS;
+    if (grain < minGrain){
+        grain = minGrain;
+    }
+
+    _ReduceBody<_Tp, _Body> body(fn, begin, grain);
+    _parallelRun(executor, begin, end, grain, _callChunk<_ReduceBody<_Tp, _Body>>, &body);
+
+    _Tp result = std::move(identity);
+    size_t chunks = (count + grain - 1) / grain;
+    for (size_t i = 0; i < chunks; i++){
+        _Tp* partial = body.partial(i);
+        result = combine(std::move(result), std::move(*partial));
+        partial->~_Tp();
+    }
+    return result;
+}
+
+END_TASKS_NAMESPACE
@@ -1,12 +1,10 @@
 #include "Scheduler.h"
 
-BEGIN_TASKS_NAMESPACE
-
-int Scheduler::_instance_count = 0;
+#include <algorithm>
+#include <new>
+#include <sys/time.h>
 
-bool _compareScheduledTask(const _ScheduledTask& a, const _ScheduledTask& b){
-  return a.nextExecution > b.nextExecution;
-}
+BEGIN_TASKS_NAMESPACE
 
 _clock getNow(){
   return pdTICKS_TO_MS(xTaskGetTickCount());
@@ -18,51 +16,349 @@ time_t to_time_t(_clock time){
 
 // execute a task if this is the correct time, and return the time until the next execution in milliseconds
 double Scheduler::_executeTask(Scheduler* scheduler, struct _ScheduledTask& task){
-  if(task.nextExecution <= scheduler->_now){
+  if(!_ClockBefore()(scheduler->_now, task.nextExecution)){
     
-    // make a copy of the task, and run it
-    AsyncTask<>(task.task).run();
-    // update the next execution time
-    task.nextExecution = task.schedule.schedule(scheduler->_now);
-
-    // time_t temp = to_time_t(task.nextExecution);
-    // struct tm next = *localtime(&temp);
-
-    // // Get the number of milliseconds
-    // auto milliseconds = task.nextExecution % 1000;
-    // Serial.println("Next execution " + String(task.task._params.name.c_str()) + ": " + String(next.tm_hour) + ":" + String(next.tm_min) + ":" + String(next.tm_sec) + ":" + String(milliseconds));
+    Executor* executor = task.task._params.executor ? task.task._params.executor : scheduler->_executor;
+    _clock planned = task.nextExecution;
+
+    // cron tasks wake up early now and then, to follow changes of the system time
+    if (task.schedule.onCalendar && !_calendarDue(task)){
+      task.nextExecution = scheduler->_now + _planCalendar(task, false);
+      return int32_t(task.nextExecution - scheduler->_now);
+    }
+
+    // number of deadlines after this one, that already passed too
+    uint32_t interval = task.schedule.interval();
+    uint32_t missed = interval > 0 ? (scheduler->_now - planned) / interval : 0;
+    bool skip = false;
+    if (missed > 0 && task.schedule.policy != ExecutionPolicy::Dedicated){
+      switch(task.schedule.overrun){
+        case OverrunPolicy::Skip:
+          // this firing is missed too
+          task.counters._skip(missed + 1);
+          skip = true;
+          break;
+        case OverrunPolicy::Coalesce:
+          task.counters._skip(missed);
+          break;
+        default:
+          break;
+      }
+    }
+
+    if (!skip){
+      switch(task.schedule.policy){
+        case ExecutionPolicy::Inline:
+          // run by `_runLockedTask()` once the lock is released, the slot isn't reused meanwhile
+          task.inFlight.fetch_add(1, std::memory_order_relaxed);
+          scheduler->_inline.emplace_back(planned, &task);
+          break;
+        case ExecutionPolicy::Dedicated:
+          _startDedicated(task);
+          break;
+        case ExecutionPolicy::Pooled:
+          // the stored task is submitted, no copy is made
+          task.planned.store(planned, std::memory_order_relaxed);
+          task.inFlight.fetch_add(1, std::memory_order_relaxed);
+          if (executor && executor->submit(_pooledRunner, &task)){
+            break;
+          }
+          task.inFlight.fetch_sub(1, std::memory_order_relaxed);
+          // no executor or it's full, spawn a task instead
+          // fall through
+        default: {
+          // run a copy of the task function on its own FreeRTOS task, on the
+          // scheduler's executor if the task doesn't have its own
+          AsyncTask<struct _ScheduledTask*, _clock, InplaceFunction<void()>> copy(task.task._params, _spawnedRunner);
+          copy._params.executor = executor;
+          copy._params.priority = _boostedPriority(task.schedule, copy._params.priority, planned, scheduler->_now);
+          task.inFlight.fetch_add(1, std::memory_order_relaxed);
+          if (!copy.run(&task, planned, task.task._task)){
+            // out of pool slots or stacks (static mode), this firing is lost
+            task.inFlight.fetch_sub(1, std::memory_order_relaxed);
+            task.counters._skip(1);
+          }
+          break;
+        }
+      }
+    }
+    // the next deadline follows from this one, not from the time it ran, so
+    // late firings don't make the task drift
+    if (task.schedule.onCalendar){
+      // a started dedicated task plans its own firings
+      if (!task.dedicated){
+        task.nextExecution = scheduler->_now + _planCalendar(task, true);
+      }
+    } else {
+      task.nextExecution = task.schedule.next(planned, scheduler->_now);
+    }
   } 
   // return the time until the next execution in milliseconds
-  return task.nextExecution - scheduler->_now;
+  return int32_t(task.nextExecution - scheduler->_now);
 }
 
 double Scheduler::_runLockedTask(Scheduler* scheduler){
   double minTime = INT_MAX;
 
-  // time_t temp = to_time_t(scheduler->_now);
-  // struct tm* now = localtime(&temp);
+  // held until the end of the tick, `stop()` and `pause()` wait for it
+  Lock tick(scheduler->_tickMutex);
+  std::vector<std::pair<_clock, struct _ScheduledTask*>>& inlineJobs = scheduler->_inline;
+  inlineJobs.clear();
+
+  {
+    // lock the mutex
+    Lock lock(scheduler->_mutex);
+
+    // update the current time
+    scheduler->_now = getNow();
+
+    _IndexedHeap<_clock>& queue = scheduler->_queue;
+    _ClockBefore before;
+
+    // pop all the tasks that are due first, so every task runs at most once per tick
+    // (a task with a zero interval would be due again right away)
+    std::vector<std::pair<int64_t, uint32_t>>& due = scheduler->_due;
+    due.clear();
+    while(!queue.empty() && !before(scheduler->_now, queue.topKey())){
+      _clock planned = queue.topKey();
+      uint32_t id = queue.pop();
+      _clock deadline = scheduler->_tasks[id].schedule.relativeDeadline();
+      // the deadline relative to now, negative once it passed, so the keys compare
+      // as plain numbers across the wrap of the clock, tasks without a deadline go last
+      int64_t left = deadline ? int64_t(deadline) - int32_t(scheduler->_now - planned) : INT64_MAX;
+      due.emplace_back(left, id);
+    }
+
+    // earliest deadline first, in the order they were added on a tie
+    std::sort(due.begin(), due.end());
+
+    for(const std::pair<int64_t, uint32_t>& entry : due){
+      struct _ScheduledTask& task = scheduler->_tasks[entry.second];
+      _executeTask(scheduler, task);
+
+      // dedicated tasks keep their own time, until the scheduler is stopped
+      if (!task.dedicated){
+        queue.push(entry.second, task.nextExecution);
+      }
+    }
+  }
+
+  // inline jobs run without the mutex, in the order they were due, so they can
+  // add, remove, pause or reschedule jobs of this scheduler, themselves too
+  for(const std::pair<_clock, struct _ScheduledTask*>& job : inlineJobs){
+    _runMeasured(*job.second, job.first);
+    job.second->inFlight.fetch_sub(1, std::memory_order_release);
+  }
 
-  // auto milliseconds = scheduler->_now % 1000;
-  // Serial.println("Now: " + String(now->tm_hour) + ":" + String(now->tm_min) + ":" + String(now->tm_sec) + ":" + String(milliseconds));
+  // measured after the tick, inline tasks may have taken a while
+  Lock lock(scheduler->_mutex);
+  if (!scheduler->_queue.empty()){
+    minTime = int32_t(scheduler->_wakeTime() - getNow());
+  }
 
-  // lock the mutex
-  Lock lock(scheduler->_taskData->_mutex);
+  // return the time until the next task in milliseconds
+  return std::max(minTime, 1.0);
+}
 
-  // iterate over all the tasks, and execute them
-  for(auto it = scheduler->_tasks.begin(); it != scheduler->_tasks.end(); it++){
-    minTime = std::min(minTime, _executeTask(scheduler, *it));
+void Scheduler::_startDedicated(struct _ScheduledTask& task){
+  const TaskParams& params = task.task._params;
+  TaskHandle_t handle = BaseAsyncTask::_createTask(
+    _dedicatedRunner, params.name, params.stackSize, &task, params.priority, params
+  );
+  if (!handle){
+    return;
   }
+  task.inFlight.fetch_add(1, std::memory_order_relaxed);
+  task.dedicated.store(handle);
+  // the task waits for this, so it never checks `dedicated` before it's stored
+  xTaskNotifyGive(handle);
+}
 
-  // sort the tasks by the next execution time
-  scheduler->_tasks.sort(_compareScheduledTask);
+void Scheduler::_cancelDedicated(struct _ScheduledTask& task){
+  TaskHandle_t handle = task.dedicated.exchange(NULL);
+  if (!handle){
+    return;
+  }
+  // wake it from its sleep, and from a pause of the job or the scheduler, a task
+  // cancelling itself sees it once its run returns
+  xTaskNotifyGive(handle);
+  vTaskResume(handle);
+}
 
-  // Serial.println("Min time: " + String(minTime) + "\n");
+bool Scheduler::_sleepDedicated(struct _ScheduledTask& task, TickType_t wake){
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  for(;;){
+    if (task.dedicated.load() != self){
+      return false;
+    }
+    int32_t left = int32_t(wake - xTaskGetTickCount());
+    if (left <= 0){
+      return true;
+    }
+    // a notification left by the task function wakes us up early, sleep again
+    ulTaskNotifyTake(pdTRUE, TickType_t(left));
+  }
+}
 
-  // update the current time
-  scheduler->_now = getNow();
+void Scheduler::_exitDedicated(struct _ScheduledTask& task){
+  // the slot may be reused (or the scheduler destroyed) right after this
+  task.inFlight.fetch_sub(1, std::memory_order_release);
+  BaseAsyncTask::_exitTask();
+}
 
-  // return the time until the next task in milliseconds
-  return std::max(minTime, 10.0);
+void Scheduler::_dedicatedRunner(void* param){
+  struct _ScheduledTask* task = static_cast<struct _ScheduledTask*>(param);
+  // sent by `_startDedicated()`, once this task is the job's one
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+  TickType_t period = std::max<TickType_t>(pdMS_TO_TICKS(task->schedule.interval()), 1);
+  TickType_t timer = xTaskGetTickCount();
+
+  if (task->schedule.onCalendar){
+    for(;;){
+      _runMeasured(*task, pdTICKS_TO_MS(xTaskGetTickCount()));
+      bool fired = true;
+      do {
+        TickType_t wait = std::max<TickType_t>(pdMS_TO_TICKS(_planCalendar(*task, fired)), 1);
+        if (!_sleepDedicated(*task, xTaskGetTickCount() + wait)){
+          return _exitDedicated(*task);
+        }
+        fired = false;
+      } while (!_calendarDue(*task));
+    }
+  }
+
+  for(;;){
+    _runMeasured(*task, pdTICKS_TO_MS(timer));
+    // like `vTaskDelayUntil()`, but the job can be cancelled meanwhile
+    timer += period;
+    if (!_sleepDedicated(*task, timer)){
+      return _exitDedicated(*task);
+    }
+    // resumed after a pause: keep the phase, but skip the deadlines that passed
+    // meanwhile, like the other jobs, instead of catching up on every one of them
+    while (task->resumed.exchange(false)){
+      timer += (xTaskGetTickCount() - timer) / period * period + period;
+      if (!_sleepDedicated(*task, timer)){
+        return _exitDedicated(*task);
+      }
+    }
+  }
+}
+
+// the system time is considered not set before this, 2021-01-01
+static const time_t _validWallTime = 1609459200;
+// longest sleep of a cron task, it follows changes of the system time (SNTP
+// corrections, time zone) at least this often, also keeps the wait far from
+// the wrap around of the millisecond clock
+static const _clock _maxCalendarWait = 3600000;
+
+_clock Scheduler::_planCalendar(struct _ScheduledTask& task, bool fired){
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  if (now.tv_sec < _validWallTime){
+    task.wallTime = 0;
+    return 1000;
+  }
+
+  time_t after = fired ? std::max(task.wallTime, now.tv_sec) : now.tv_sec;
+  time_t next = task.schedule.calendar.next(after);
+  if (next == time_t(-1)){
+    // invalid, or never matches
+    task.wallTime = 0;
+    return _maxCalendarWait;
+  }
+  task.wallTime = next;
+
+  int64_t wait = int64_t(next - now.tv_sec) * 1000 - now.tv_usec / 1000;
+  return _clock(std::min<int64_t>(std::max<int64_t>(wait, 0), _maxCalendarWait));
+}
+
+bool Scheduler::_calendarDue(const struct _ScheduledTask& task){
+  if (task.wallTime == 0){
+    return false;
+  }
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return now.tv_sec >= task.wallTime;
+}
+
+void Scheduler::_pooledRunner(void* param){
+  struct _ScheduledTask* task = static_cast<struct _ScheduledTask*>(param);
+  _runMeasured(*task, task->planned.load(std::memory_order_relaxed));
+  task->inFlight.fetch_sub(1, std::memory_order_release);
+}
+
+void Scheduler::_spawnedRunner(struct _ScheduledTask* task, _clock planned, InplaceFunction<void()> fn){
+  _measure(*task, planned, fn);
+  task->inFlight.fetch_sub(1, std::memory_order_release);
+}
+
+void Scheduler::_runMeasured(struct _ScheduledTask& task, _clock planned){
+  _measure(task, planned, task.task._task);
+}
+
+UBaseType_t Scheduler::_boostedPriority(const ScheduleParams& schedule, UBaseType_t base, _clock planned, _clock now){
+  _clock window = schedule.relativeDeadline();
+  int32_t late = int32_t(now - planned);
+  if (schedule.maxPriority <= base || window == 0 || late <= 0){
+    return base;
+  }
+  if (uint32_t(late) >= window){
+    return schedule.maxPriority;
+  }
+  return base + UBaseType_t(uint64_t(schedule.maxPriority - base) * uint32_t(late) / window);
+}
+
+void Scheduler::_measure(struct _ScheduledTask& task, _clock planned, const InplaceFunction<void()>& fn){
+  _clock now = getNow();
+  int32_t late = int32_t(now - planned);
+  task.counters._start(late > 0 ? uint32_t(late) : 0);
+
+  // a late run may be raised more than when it was dispatched, it waited in
+  // the ready list or the executor's queue, restore the priority after the run,
+  // the worker of an executor runs other jobs too
+  UBaseType_t base = uxTaskPriorityGet(NULL);
+  UBaseType_t boosted = _boostedPriority(task.schedule, base, planned, now);
+  if (boosted != base){
+    vTaskPrioritySet(NULL, boosted);
+  }
+
+  uint32_t start = micros();
+  if (fn){
+    fn();
+  }
+  task.counters._end(uint32_t(micros() - start));
+
+  if (boosted != base){
+    vTaskPrioritySet(NULL, base);
+  }
+  _clock deadline = task.schedule.relativeDeadline();
+  if (deadline && int32_t(getNow() - planned) > int32_t(deadline)){
+    task.counters._miss();
+  }
+}
+
+_clock Scheduler::_wakeTime() const{
+  _clock latest = _queue.topKey() + _tasks[_queue.top()].schedule.slack;
+  _wakeTimeFrom(1, latest);
+  _wakeTimeFrom(2, latest);
+  return latest;
+}
+
+void Scheduler::_wakeTimeFrom(size_t index, _clock& latest) const{
+  // keys only grow down the heap and slack isn't negative, so nothing below a node
+  // that starts at or after `latest` can lower it, without slack only the root's
+  // children are looked at
+  if (index >= _queue.size() || !_ClockBefore()(_queue.keyAt(index), latest)){
+    return;
+  }
+  _clock end = _queue.keyAt(index) + _tasks[_queue.idAt(index)].schedule.slack;
+  if (_ClockBefore()(end, latest)){
+    latest = end;
+  }
+  _wakeTimeFrom(2 * index + 1, latest);
+  _wakeTimeFrom(2 * index + 2, latest);
 }
 
 void Scheduler::_taskRunner(void* param){
@@ -70,39 +366,76 @@ void Scheduler::_taskRunner(void* param){
   
   Main task for the `Scheduler` class.
 
-  This task will run all the tasks in the `Scheduler`'s task list, and will
-  sleep for the `frequency` time, and then run the tasks again.
+  This task will run all the tasks in the `Scheduler`'s task list that are due,
+  and will sleep until the next task is due, then run the tasks again.
+  The sleep is a wait for a task notification, so `addTask` and `resume` can wake
+  the runner early, when an earlier task arrives.
   Basically, this is the main loop of the `Scheduler` class, where all the tasks
   are executed.
   
   */
   Scheduler* scheduler = static_cast<Scheduler*>(param);
 
-  scheduler->_now = getNow();
-  
-  // The frequency of the task runner, using 50ms as the default
-  TickType_t frequency = pdMS_TO_TICKS(50);
-  TickType_t timer = xTaskGetTickCount();
-
   for(;;){
-    vTaskDelayUntil(&timer, frequency);
-    _runLockedTask(scheduler);
+    // counted before the tick: once it released the lock, `stop()` may delete this task
+    // and destroy the scheduler, the scheduler must not be touched until the next wait
+    scheduler->_wakeups.fetch_add(1, std::memory_order_relaxed);
+    double wait = _runLockedTask(scheduler);
+
+    // no tasks at all, sleep until one is added, otherwise round the wait up
+    // to whole ticks, so we don't wake up just before the deadline
+    TickType_t ticks = portMAX_DELAY;
+    if (wait < INT_MAX){
+      ticks = (TickType_t(wait) + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
+    }
+    ulTaskNotifyTake(pdTRUE, ticks);
   }
 }
 
-Scheduler::Scheduler():
-  _taskData(nullptr), _now(), _tasks(), _params()
-{
-  if(_instance_count == 0){
-    _instance_count++;
-  } else {
-    throw std::runtime_error("Only one instance of Scheduler is allowed");
+Scheduler::Scheduler(size_t capacity):
+  _taskData(NULL, _TaskSignal::STOP), _mutex(xSemaphoreCreateMutex()), _tickMutex(xSemaphoreCreateMutex()), _now(getNow()), _tasks(), _free(), _capacity(capacity),
+  _queue(), _params(), _executor(nullptr), _wakeups(0), _firingRate(0) {
+  if (!capacity){
+    return;
   }
+  // every slot starts removed, the first one is taken first
+  _tasks.resize(capacity);
+  _free.reserve(capacity);
+  for(size_t id = capacity; id-- > 0;){
+    _tasks[id].active = false;
+    _free.push_back(uint32_t(id));
+  }
+  _queue.reserve(capacity);
+  _due.reserve(capacity);
+  _inline.reserve(capacity);
 }
 
 Scheduler::~Scheduler(){
   stop();
-  _instance_count--;
+  {
+    // started by `execute()`, without a scheduler task to stop
+    Lock lock(_mutex);
+    for(auto& task : _tasks){
+      _cancelDedicated(task);
+    }
+  }
+  // runs handed to an executor or spawned on their own task still read their slot
+  // and update its counters, the slots must outlive them
+  for(auto& task : _tasks){
+    while(task.inFlight.load(std::memory_order_acquire) != 0){
+      vTaskDelay(1);
+    }
+  }
+  vSemaphoreDelete(_tickMutex);
+  vSemaphoreDelete(_mutex);
+}
+
+double Scheduler::_rateOf(const ScheduleParams& schedule){
+  if (schedule.onCalendar){
+    return 1.0 / 60;
+  }
+  // an interval of 0 runs on every tick
+  return 1000.0 / std::max<_clock>(schedule.interval(), portTICK_PERIOD_MS);
 }
 
 Scheduler& Scheduler::setParams(const TaskParams& params){
@@ -110,47 +443,200 @@ Scheduler& Scheduler::setParams(const TaskParams& params){
   return *this;
 }
 
-Scheduler& Scheduler::addTask(const AsyncTask<>& task, ScheduleParams schedule){
+Scheduler& Scheduler::setExecutor(Executor* executor){
+  _executor = executor;
+  return *this;
+}
+
+JobHandle Scheduler::addTask(const AsyncTask<>& task, ScheduleParams schedule){
+  return addTask(AsyncTask<>(task), schedule);
+}
+
+JobHandle Scheduler::addTask(AsyncTask<>&& task, ScheduleParams schedule){
   // Add a task to the list of tasks, user might have called `run` before adding tasks
-  // so we must check if the taskData is initialized and use the mutex, same for the
-  // other setter methods
-  if (_taskData){
-    Lock lock(_taskData->_mutex);
-    _tasks.emplace_back(task, schedule);
+  // so we must use the mutex, same for the other setter methods
+  Lock lock(_mutex);
+
+  // reuse the slot of a removed task, unless a run still reads it
+  size_t reusable = _free.size();
+  for(size_t i = _free.size(); i-- > 0 && reusable == _free.size();){
+    if (_tasks[_free[i]].inFlight.load(std::memory_order_acquire) == 0){
+      reusable = i;
+    }
+  }
+  // in static mode `_tasks` never grows, a scheduler without a capacity has no room
+  if (reusable == _free.size() && (_capacity || ASYNC_TASKS_STATIC)){
+    return JobHandle();
+  }
+
+  uint32_t id;
+  if (reusable < _free.size()){
+    id = _free[reusable];
+    _free[reusable] = _free.back();
+    _free.pop_back();
+    struct _ScheduledTask& slot = _tasks[id];
+    uint32_t generation = slot.generation + 1;
+    slot.~_ScheduledTask();
+    new (&slot) _ScheduledTask(std::move(task), schedule);
+    slot.generation = generation;
   } else {
-    _tasks.emplace_back(task, schedule);
+    id = uint32_t(_tasks.size());
+    _tasks.emplace_back(std::move(task), schedule);
   }
-  return *this;
+
+  _enqueue(id);
+  _firingRate += _rateOf(schedule);
+  return JobHandle(id, _tasks[id].generation);
 }
 
-Scheduler& Scheduler::addTask(std::function<void(void)> task, const TaskParams& params, const ScheduleParams& schedule){
-  return addTask(AsyncTask<>(params, task), schedule);
+JobHandle Scheduler::addTask(InplaceFunction<void()> task, const TaskParams& params, const ScheduleParams& schedule){
+  return addTask(AsyncTask<>(params, std::move(task)), schedule);
 }
 
-Scheduler& Scheduler::addTask(std::function<void(void)> task, const ScheduleParams& schedule){
-  return addTask(AsyncTask<>(task), schedule);
+JobHandle Scheduler::addTask(InplaceFunction<void()> task, const ScheduleParams& schedule){
+  return addTask(AsyncTask<>(std::move(task)), schedule);
+}
+
+void Scheduler::_enqueue(uint32_t id){
+  struct _ScheduledTask& task = _tasks[id];
+  // due right away (or after the offset), the first execution happens on the
+  // next tick, the later deadlines are anchored to this one
+  task.nextExecution = getNow() + task.schedule.offset;
+  if (task.schedule.onCalendar){
+    task.wallTime = 0;
+    task.nextExecution = getNow() + _planCalendar(task, false);
+  }
+  _queue.push(id, task.nextExecution);
+
+  // the runner sleeps until the previous first deadline, wake it up
+  if (_queue.top() == id){
+    _wakeRunner();
+  }
+}
+
+struct _ScheduledTask* Scheduler::_find(JobHandle handle){
+  if (handle.index >= _tasks.size()){
+    return nullptr;
+  }
+  struct _ScheduledTask& task = _tasks[handle.index];
+  return task.active && task.generation == handle.generation ? &task : nullptr;
+}
+
+bool Scheduler::contains(JobHandle handle){
+  Lock lock(_mutex);
+  return _find(handle) != nullptr;
+}
+
+bool Scheduler::remove(JobHandle handle){
+  Lock lock(_mutex);
+  struct _ScheduledTask* task = _find(handle);
+  if (!task){
+    return false;
+  }
+  _queue.remove(handle.index);
+  _cancelDedicated(*task);
+  task->active = false;
+  _free.push_back(handle.index);
+  if (!task->paused){
+    _firingRate -= _rateOf(task->schedule);
+  }
+  return true;
+}
+
+bool Scheduler::reschedule(JobHandle handle, const ScheduleParams& schedule){
+  Lock lock(_mutex);
+  struct _ScheduledTask* task = _find(handle);
+  if (!task){
+    return false;
+  }
+  // a new dedicated task starts on the next firing, with the new schedule
+  _cancelDedicated(*task);
+  if (!task->paused){
+    _firingRate += _rateOf(schedule) - _rateOf(task->schedule);
+  }
+  task->schedule = schedule;
+  if (task->paused){
+    // planned again by `resume()`
+    return true;
+  }
+  _queue.remove(handle.index);
+  _enqueue(handle.index);
+  return true;
 }
 
-void Scheduler::run(){
+bool Scheduler::pause(JobHandle handle){
+  Lock lock(_mutex);
+  struct _ScheduledTask* task = _find(handle);
+  if (!task){
+    return false;
+  }
+  if (!task->paused){
+    task->paused = true;
+    _firingRate -= _rateOf(task->schedule);
+    _queue.remove(handle.index);
+    if (task->dedicated){
+      vTaskSuspend(task->dedicated);
+    }
+  }
+  return true;
+}
+
+bool Scheduler::resume(JobHandle handle){
+  Lock lock(_mutex);
+  struct _ScheduledTask* task = _find(handle);
+  if (!task){
+    return false;
+  }
+  if (!task->paused){
+    return true;
+  }
+  task->paused = false;
+  _firingRate += _rateOf(task->schedule);
+
+  if (task->dedicated){
+    // resumed with the scheduler, if it's paused too
+    task->resumed.store(true);
+    if (_taskData._signal != _TaskSignal::PAUSE){
+      vTaskResume(task->dedicated);
+    }
+    return true;
+  }
+
+  _clock now = getNow();
+  _clock interval = task->schedule.interval();
+  if (task->schedule.onCalendar){
+    task->wallTime = 0;
+    task->nextExecution = now + _planCalendar(*task, false);
+  } else if (interval > 0 && !_ClockBefore()(now, task->nextExecution)){
+    // keep the phase, skip the deadlines that passed while paused
+    task->nextExecution += ((now - task->nextExecution) / interval + 1) * interval;
+  }
+  _queue.push(handle.index, task->nextExecution);
+  if (_queue.top() == handle.index){
+    _wakeRunner();
+  }
+  return true;
+}
+
+bool Scheduler::run(){
 
   // if the scheduler is already running, return
-  if (_taskData != nullptr){
-    return;
+  if (_taskData._signal != _TaskSignal::STOP){
+    return true;
   }
-  
-  _taskData.reset(new _TaskData());
 
   _now = getNow();
   
-  if(_params.usePinnedCore){
-    xTaskCreatePinnedToCore(
-      _taskRunner, "Scheduler", _params.stackSize, this, tskIDLE_PRIORITY, &_taskData->_handle, _params.core
-    );
-  } else{
-    xTaskCreate(
-      _taskRunner, "Scheduler", _params.stackSize, this, tskIDLE_PRIORITY, &_taskData->_handle
-    );
+  TaskHandle_t handle = BaseAsyncTask::_createTask(
+    _taskRunner, "Scheduler", _params.stackSize, this, tskIDLE_PRIORITY, _params
+  );
+  if (!handle){
+    // stay stopped, `stop()` and `pause()` must not act on a NULL handle (the calling task)
+    return false;
   }
+  _taskData._handle.store(handle);
+  _taskData._signal = _TaskSignal::RUN;
+  return true;
 }
 
 void Scheduler::execute(){
@@ -158,28 +644,114 @@ void Scheduler::execute(){
 }
 
 void Scheduler::stop(){
-  if (_taskData == nullptr || _taskData->_signal != _TaskSignal::RUN){
+  // a paused scheduler is stopped too, its suspended tasks are deleted the same way,
+  // so none of them is left holding a pointer into a destroyed scheduler
+  _TaskSignal signal = _taskData._signal;
+  if ((signal != _TaskSignal::RUN && signal != _TaskSignal::PAUSE) || !_taskData._handle){
     return;
   }
-  Lock lock(_taskData->_mutex);
-  vTaskDelete(_taskData->_handle);
-  _taskData.reset();
+  Lock tick(_tickMutex);
+  Lock lock(_mutex);
+  BaseAsyncTask::_killTask(_taskData._handle, _params.stacks);
+  _taskData._handle.store(NULL);
+  _taskData._signal = _TaskSignal::STOP;
+
+  // kill the dedicated tasks, and put them back to the queue, so they start again on `run`
+  for(size_t id = 0; id < _tasks.size(); id++){
+    if (_tasks[id].dedicated){
+      BaseAsyncTask::_killTask(_tasks[id].dedicated, _tasks[id].task._params.stacks);
+      _tasks[id].dedicated = NULL;
+      _tasks[id].inFlight.fetch_sub(1, std::memory_order_release);
+      _tasks[id].nextExecution = _now;
+      // a cron task plans its next firing again
+      _tasks[id].wallTime = 0;
+      if (!_tasks[id].paused){
+        _queue.push(uint32_t(id), _now);
+      }
+    }
+  }
 }
 
 void Scheduler::pause(){
-  if (_taskData == nullptr || _taskData->_signal != _TaskSignal::RUN){
+  if (_taskData._signal != _TaskSignal::RUN || !_taskData._handle){
     return;
   }
-  vTaskSuspend(_taskData->_handle);
-  _taskData->_signal = _TaskSignal::PAUSE;
+  // with the tick lock held, the scheduler task can't be in the middle of a tick
+  Lock tick(_tickMutex);
+  Lock lock(_mutex);
+  vTaskSuspend(_taskData._handle);
+  _taskData._signal = _TaskSignal::PAUSE;
+
+  for(auto& task : _tasks){
+    if (task.dedicated){
+      vTaskSuspend(task.dedicated);
+    }
+  }
 }
 
 void Scheduler::resume(){
-  if (_taskData == nullptr || _taskData->_signal != _TaskSignal::PAUSE){
+  if (_taskData._signal != _TaskSignal::PAUSE || !_taskData._handle){
     return;
   }
-  _taskData->_signal = _TaskSignal::RUN;
-  vTaskResume(_taskData->_handle);
+  {
+    Lock lock(_mutex);
+    for(auto& task : _tasks){
+      // jobs paused on their own stay paused
+      if (task.dedicated && !task.paused){
+        task.resumed.store(true);
+        vTaskResume(task.dedicated);
+      }
+    }
+  }
+
+  _taskData._signal = _TaskSignal::RUN;
+  vTaskResume(_taskData._handle);
+  // deadlines might have passed while paused
+  _wakeRunner();
+}
+
+void Scheduler::_wakeRunner(){
+  TaskHandle_t handle = _taskData._handle.load();
+  if (handle){
+    xTaskNotifyGive(handle);
+  }
+}
+
+uint32_t Scheduler::wakeups() const{
+  return _wakeups.load(std::memory_order_relaxed);
+}
+
+size_t Scheduler::taskCount(){
+  Lock lock(_mutex);
+  return _tasks.size() - _free.size();
+}
+
+double Scheduler::firingRate(){
+  Lock lock(_mutex);
+  return _firingRate;
+}
+
+TaskStats Scheduler::stats(size_t index){
+  // the lock only keeps `_tasks` from growing while we look up the task,
+  // the counters themselves are atomic
+  Lock lock(_mutex);
+  if (index >= _tasks.size()){
+    return _TaskCounters().snapshot();
+  }
+  return _tasks[index].counters.snapshot();
+}
+
+TaskStats Scheduler::stats(JobHandle handle){
+  Lock lock(_mutex);
+  struct _ScheduledTask* task = _find(handle);
+  return task ? task->counters.snapshot() : _TaskCounters().snapshot();
+}
+
+void Scheduler::resetStats(){
+  Lock lock(_mutex);
+  for(auto& task : _tasks){
+    task.counters.reset();
+  }
 }
 
 END_TASKS_NAMESPACE
\ No newline at end of file
@@ -1,11 +1,29 @@
 #pragma once
 
-#include <queue>
-#include <list>
+#include <atomic>
+#include <deque>
+#include <utility>
+#include <vector>
 
 #include "./AsyncTask.h"
 #include "./schedules.h"
 #include "./lock.h"
+#include "./indexed_heap.h"
+#include "./task_stats.h"
+
+// jobs a `Scheduler` has room for, allocated when it's created, 0 for no limit
+#ifndef ASYNC_TASKS_SCHEDULER_CAPACITY
+#   if ASYNC_TASKS_STATIC
+#       define ASYNC_TASKS_SCHEDULER_CAPACITY 16
+#   else
+#       define ASYNC_TASKS_SCHEDULER_CAPACITY 0
+#   endif
+#endif
+
+#if ASYNC_TASKS_STATIC
+static_assert(ASYNC_TASKS_SCHEDULER_CAPACITY > 0,
+  "A Scheduler without a capacity grows on the heap, ASYNC_TASKS_SCHEDULER_CAPACITY must be above 0 in static mode");
+#endif
 
 BEGIN_TASKS_NAMESPACE
 
@@ -18,14 +36,75 @@ struct _ScheduledTask{
   ScheduleParams schedule;
   // nextExecution is used to store the next time the task should be executed
   _clock nextExecution;
+  // long-lived task running this task, with `ExecutionPolicy::Dedicated`, a task
+  // that isn't this one anymore (removed, rescheduled) exits once it's done
+  std::atomic<TaskHandle_t> dedicated;
+  // planned start of the latest firing, read by the job with `ExecutionPolicy::Pooled`
+  std::atomic<_clock> planned;
+  // timing statistics
+  _TaskCounters counters;
+  // wall clock time of the next firing of a cron schedule, 0 if not planned
+  time_t wallTime;
+  // incremented every time the slot is reused, see `JobHandle`
+  uint32_t generation;
+  // false once the job is removed, the slot can be reused
+  bool active;
+  // paused with `Scheduler::pause(JobHandle)`, out of the queue
+  bool paused;
+  // runs handed to another task (Spawn, Pooled) that didn't return yet, and the
+  // dedicated tasks that didn't exit, the slot isn't reused while they may still read it
+  std::atomic<uint32_t> inFlight;
+  // set by `resume()`, the dedicated task skips the deadlines that passed while paused
+  std::atomic<bool> resumed;
 
   _ScheduledTask(): _ScheduledTask(AsyncTask<>(), ScheduleParams()) {}
 
   _ScheduledTask(const AsyncTask<>& task, const ScheduleParams& schedule):
-    task(task), schedule(schedule), nextExecution(0) {}
+    task(task), schedule(schedule), nextExecution(0), dedicated(NULL), planned(0), counters(), wallTime(0),
+    generation(0), active(true), paused(false), inFlight(0), resumed(false) {}
+
+  _ScheduledTask(AsyncTask<>&& task, const ScheduleParams& schedule):
+    task(std::move(task)), schedule(schedule), nextExecution(0), dedicated(NULL), planned(0), counters(), wallTime(0),
+    generation(0), active(true), paused(false), inFlight(0), resumed(false) {}
 
   _ScheduledTask(const _ScheduledTask& other):
-    task(other.task), schedule(other.schedule), nextExecution(other.nextExecution) {}
+    task(other.task), schedule(other.schedule), nextExecution(other.nextExecution), dedicated(NULL),
+    planned(other.planned.load()), counters(), wallTime(other.wallTime),
+    generation(other.generation), active(other.active), paused(other.paused), inFlight(0), resumed(false) {}
+};
+
+/**
+ * Handle of a job added to a `Scheduler`, to remove, reschedule, pause or resume it.
+ * Stays valid until the job is removed, a handle of a removed job is rejected
+ * even after its slot is reused by a new job
+*/
+struct JobHandle{
+  // slot of the job in the scheduler
+  uint32_t index;
+  // generation of the slot when the job was added
+  uint32_t generation;
+  // shard of a `ShardedScheduler` the job was placed on, 0 for a `Scheduler`
+  uint32_t shard;
+
+  JobHandle(): index(UINT32_MAX), generation(0), shard(0) {}
+  JobHandle(uint32_t index, uint32_t generation, uint32_t shard = 0):
+    index(index), generation(generation), shard(shard) {}
+
+  /**
+   * @brief False for a default constructed handle, doesn't check if the job still exists,
+   * see `Scheduler::contains()`
+  */
+  bool valid() const{
+    return index != UINT32_MAX;
+  }
+
+  bool operator==(const JobHandle& other) const{
+    return index == other.index && generation == other.generation && shard == other.shard;
+  }
+
+  bool operator!=(const JobHandle& other) const{
+    return !(*this == other);
+  }
 };
 
 /*
@@ -52,28 +131,118 @@ scheduler.run();
 */
 class Scheduler
 {
-  static int _instance_count;
-  std::unique_ptr<_TaskData> _taskData;
+  // handle and state of the scheduler task, `_TaskSignal::STOP` while it isn't running
+  _TaskData _taskData;
+  // guards the tasks and the queue, shared by the scheduler task and the setters
+  SemaphoreHandle_t _mutex;
+  // held by the scheduler task for a whole tick, inline jobs included, so `stop()`
+  // and `pause()` never catch it in the middle of one, taken before `_mutex`
+  SemaphoreHandle_t _tickMutex;
   _clock _now;
-  std::list<struct _ScheduledTask> _tasks;
+  // tasks are never moved, index in `_tasks` is the id used in `_queue`
+  std::deque<struct _ScheduledTask> _tasks;
+  // slots of the removed tasks, reused by `addTask()`
+  std::vector<uint32_t> _free;
+  // number of slots, all allocated up front, 0 if `_tasks` grows as needed
+  size_t _capacity;
+  // ids of the tasks, ordered by their next execution time
+  _IndexedHeap<_clock> _queue;
+  // (deadline in milliseconds from now, id) of the tasks due in the current tick
+  std::vector<std::pair<int64_t, uint32_t>> _due;
+  // (planned time, task) of the inline jobs of the current tick, they run after `_mutex` is released
+  std::vector<std::pair<_clock, struct _ScheduledTask*>> _inline;
   TaskParams _params;
+  Executor* _executor;
+  // number of times the scheduler task woke up and checked the tasks
+  std::atomic<uint32_t> _wakeups;
+  // estimated firings per second of the jobs that aren't paused
+  double _firingRate;
+
+  // estimated firings per second of a job with `schedule`
+  static double _rateOf(const ScheduleParams& schedule);
+
+  // wake the scheduler task, so it recalculates the time until the next task
+  void _wakeRunner();
+
+  // the task of `handle`, nullptr if it was removed, must hold the mutex
+  struct _ScheduledTask* _find(JobHandle handle);
+
+  // put the task into the queue, due right away, after its offset, or at the next
+  // cron firing, and wake the runner if it's the new first one, must hold the mutex
+  void _enqueue(uint32_t id);
 
   // execute the task, and return the time until the next task in seconds
   static double _executeTask(Scheduler* scheduler, struct _ScheduledTask& task);
 
+  // plan the next firing of a cron task, after the current wall clock time and,
+  // if it just `fired`, after the planned one, return the time until then in milliseconds
+  static _clock _planCalendar(struct _ScheduledTask& task, bool fired);
+
+  // check if the wall clock reached the planned firing of a cron task
+  static bool _calendarDue(const struct _ScheduledTask& task);
+
+  // start the long-lived task of a task with `ExecutionPolicy::Dedicated`
+  static void _startDedicated(struct _ScheduledTask& task);
+
+  // tell the dedicated task of `task` to exit, it does after its run in progress,
+  // so it never dies holding a lock, must hold the mutex
+  static void _cancelDedicated(struct _ScheduledTask& task);
+
+  // sleep in the dedicated task until the tick count reaches `wake`, false if it was
+  // cancelled, right away if it's asleep
+  static bool _sleepDedicated(struct _ScheduledTask& task, TickType_t wake);
+
+  // end the dedicated task of `task`, once it was cancelled
+  static void _exitDedicated(struct _ScheduledTask& task);
+
+  // main loop of a task with `ExecutionPolicy::Dedicated`
+  static void _dedicatedRunner(void* param);
+
+  // job submitted to the executor, with `ExecutionPolicy::Pooled`
+  static void _pooledRunner(void* param);
+
+  // run the task function on the current thread, and record its timing
+  static void _runMeasured(struct _ScheduledTask& task, _clock planned);
+
+  // task function of the copies started with `ExecutionPolicy::Spawn`
+  static void _spawnedRunner(struct _ScheduledTask* task, _clock planned, InplaceFunction<void()> fn);
+
+  // call `fn`, boosting the priority of the current task if it starts late, and
+  // record the lateness, the execution time and deadline misses in `task.counters`
+  static void _measure(struct _ScheduledTask& task, _clock planned, const InplaceFunction<void()>& fn);
+
+  // priority of a run of `schedule`, planned at `planned`, starting at `now`,
+  // `base` on time, up to `schedule.maxPriority` at the deadline
+  static UBaseType_t _boostedPriority(const ScheduleParams& schedule, UBaseType_t base, _clock planned, _clock now);
+
   // task runner, main task for the `Scheduler` class
   static void _taskRunner(void* param);
 
-  // run the tasks, and return the time until the next task in milliseconds
+  // run the tasks that are due, and return the time until the next task in milliseconds
   static double _runLockedTask(Scheduler* scheduler);
 
+  // the latest time the scheduler can wake up with every job still in its slack,
+  // the smallest next execution plus slack, the queue must not be empty
+  _clock _wakeTime() const;
+
+  // lower `latest` to the earliest next execution plus slack in the subtree of
+  // `index` in the queue, skipping the subtrees that start after it
+  void _wakeTimeFrom(size_t index, _clock& latest) const;
+
   public:
-  // Create a new scheduler
-  // @throws std::runtime_error if the scheduler is already created, 
-  // only one instance of `Scheduler` is allowed
-  Scheduler();
+  // Create a new scheduler, each instance has its own task, lock and jobs,
+  // see `ShardedScheduler` for one per core. With a capacity, the storage of that
+  // many jobs is allocated here, `addTask()` doesn't allocate and fails when full.
+  // In static mode a capacity of 0 means no room at all, every `addTask()` fails
+  explicit Scheduler(size_t capacity = ASYNC_TASKS_SCHEDULER_CAPACITY);
+  // Stops the scheduler, and waits for the pooled and spawned runs it started to
+  // return, they hold a pointer to their job. Must not be called from one of its
+  // jobs, and the executor must still be running
   ~Scheduler();
 
+  Scheduler(const Scheduler&) = delete;
+  Scheduler& operator=(const Scheduler&) = delete;
+
   /**
    * @brief Set the parameters for the scheduler task
    * @param params The parameters to be set
@@ -81,39 +250,90 @@ class Scheduler
   */
   Scheduler& setParams(const TaskParams& params);
 
+  /**
+   * @brief Set the executor (for example a `TaskPool`) used to run the scheduled tasks,
+   * instead of creating a new FreeRTOS task for every execution. Tasks with their own
+   * `TaskParams::executor` keep using it.
+   * @param executor The executor, or nullptr to create a task for every execution
+   * @return *this
+  */
+  Scheduler& setExecutor(Executor* executor);
+
   /**
    * @brief Add a task to the scheduler
    * @param task The `AsyncTask` to be added
    * @param schedule The schedule of the task
-   * @return *this
+   * @return Handle of the job, invalid if the scheduler has a capacity and is full
+  */
+  JobHandle addTask(const AsyncTask<>& task, ScheduleParams schedule);
+
+  /**
+   * @brief Add a task to the scheduler, the task function is moved into the job
+   * @return Handle of the job, invalid if the scheduler has a capacity and is full
   */
-  Scheduler& addTask(const AsyncTask<>& task, ScheduleParams schedule);
+  JobHandle addTask(AsyncTask<>&& task, ScheduleParams schedule);
 
   /**
    * @brief Add a task to the scheduler
    * @param task function task to be added
    * @param schedule The schedule of the task
-   * @return *this
+   * @return Handle of the job
   */
-  Scheduler& addTask(std::function<void(void)> task, const ScheduleParams& schedule);
+  JobHandle addTask(InplaceFunction<void()> task, const ScheduleParams& schedule);
 
   /**
    * @brief Add a task to the scheduler
    * @param task function task to be added
    * @param params The parameters of the task
    * @param schedule The schedule of the task
-   * @return *this
+   * @return Handle of the job
   */
-  Scheduler& addTask(
-    std::function<void(void)> task, 
+  JobHandle addTask(
+    InplaceFunction<void()> task, 
     const TaskParams& params, 
     const ScheduleParams& schedule
   );
 
+  /**
+   * @brief Check if the job of `handle` wasn't removed
+  */
+  bool contains(JobHandle handle);
+
+  /**
+   * @brief Remove a job, O(log n). Its runs in progress finish, a dedicated task exits
+   * after its run in progress, a job may remove itself. The slot is reused by a later
+   * `addTask()`, once no run reads it
+   * @return false if the job was already removed
+  */
+  bool remove(JobHandle handle);
+
+  /**
+   * @brief Replace the schedule of a job, O(log n), its deadlines start again from now
+   * (or `schedule.offset` from now), a dedicated task exits after its run in progress,
+   * and a new one starts with the new schedule, a job may reschedule itself
+   * @return false if the job was removed
+  */
+  bool reschedule(JobHandle handle, const ScheduleParams& schedule);
+
+  /**
+   * @brief Stop running a job until `resume(handle)`, O(log n), suspends a dedicated task
+   * @return false if the job was removed
+  */
+  bool pause(JobHandle handle);
+
+  /**
+   * @brief Resume a job paused with `pause(handle)`, O(log n). It keeps its phase,
+   * the deadlines that passed while paused are skipped
+   * @return false if the job was removed
+  */
+  bool resume(JobHandle handle);
+
   /**
    * @brief Run the scheduler asynchronusly, and start executing the tasks
+   * @return false if the scheduler task couldn't be created (no stack left in static
+   * mode, or out of memory), the scheduler stays stopped, true if it runs
   */
-  void run();
+  bool run();
 
   /**
    * @brief Same as `run()`, but executes in the current thread,
@@ -122,13 +342,15 @@ class Scheduler
   void execute();
 
   /**
-   * @brief Stop the scheduler, killing all the tasks, must call `run` to start again
+   * @brief Stop the scheduler, killing all the tasks (also the dedicated ones),
+   * also when paused, must call `run` to start again. The pooled and spawned runs
+   * already started keep going, the destructor waits for them
   */
   void stop();
 
   /**
    * @brief Pause the scheduler, the tasks will not be executed, 
-   * doesn't affect already working tasks
+   * doesn't affect already working tasks, suspends the dedicated tasks
   */
   void pause();
 
@@ -136,6 +358,44 @@ class Scheduler
    * @brief Resume the scheduler, after it was paused
   */
   void resume();
+
+  /**
+   * @brief Number of times the scheduler task woke up since it was created,
+   * the scheduler sleeps until the next task is due, so this grows only with
+   * the number of deadlines (and tasks added while running)
+  */
+  uint32_t wakeups() const;
+
+  /**
+   * @brief Number of scheduled jobs, paused ones included
+  */
+  size_t taskCount();
+
+  /**
+   * @brief Estimated firings per second of the jobs that aren't paused, from their
+   * intervals (a cron job counts as once a minute), used to balance `ShardedScheduler`
+  */
+  double firingRate();
+
+  /**
+   * @brief Timing statistics of a task: firings, lateness, execution time, skipped
+   * deadlines and overlapping runs. Recording them doesn't take any lock.
+   * Runs still in progress keep updating them, the destructor waits for them
+   * @param index Slot of the task, `JobHandle::index`, the order of the `addTask()`
+   * calls as long as no job was removed
+  */
+  TaskStats stats(size_t index);
+
+  /**
+   * @brief Timing statistics of a job, empty if it was removed
+  */
+  TaskStats stats(JobHandle handle);
+
+  /**
+   * @brief Reset the timing statistics of all the tasks, `running` still counts
+   * the runs in progress
+  */
+  void resetStats();
 };
 
 END_TASKS_NAMESPACE
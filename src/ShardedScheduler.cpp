@@ -0,0 +1,183 @@
+#include "ShardedScheduler.h"
+
+BEGIN_TASKS_NAMESPACE
+
+ShardedScheduler::ShardedScheduler(size_t shards, size_t capacity){
+  shards = std::max<size_t>(shards, 1);
+  _shards.reserve(shards);
+  for(size_t i = 0; i < shards; i++){
+    _shards.emplace_back(new Scheduler(capacity));
+    _shards.back()->setParams(TaskParams().setUsePinnedCore(true).setCore(int(i % portNUM_PROCESSORS)));
+  }
+}
+
+ShardedScheduler& ShardedScheduler::setParams(const TaskParams& params){
+  for(size_t i = 0; i < _shards.size(); i++){
+    TaskParams pinned = params;
+    pinned.setUsePinnedCore(true).setCore(int(i % portNUM_PROCESSORS));
+    _shards[i]->setParams(pinned);
+  }
+  return *this;
+}
+
+ShardedScheduler& ShardedScheduler::setExecutor(Executor* executor){
+  for(auto& shard : _shards){
+    shard->setExecutor(executor);
+  }
+  return *this;
+}
+
+uint32_t ShardedScheduler::_place(const TaskParams& params){
+  // a pinned job goes to a shard of its core, if there is one
+  bool pinned = false;
+  if (params.usePinnedCore){
+    for(size_t i = 0; i < _shards.size(); i++){
+      pinned = pinned || int(i % portNUM_PROCESSORS) == params.core;
+    }
+  }
+
+  // the least loaded candidate, every shard's rate is read under its own lock only,
+  // so concurrent `addTask()` calls may pick the same shard
+  uint32_t best = 0;
+  double bestRate = 0;
+  bool found = false;
+  for(size_t i = 0; i < _shards.size(); i++){
+    if (pinned && int(i % portNUM_PROCESSORS) != params.core){
+      continue;
+    }
+    double rate = _shards[i]->firingRate();
+    if (!found || rate < bestRate){
+      best = uint32_t(i);
+      bestRate = rate;
+      found = true;
+    }
+  }
+  return best;
+}
+
+Scheduler* ShardedScheduler::_shardOf(JobHandle handle){
+  return handle.valid() && handle.shard < _shards.size() ? _shards[handle.shard].get() : nullptr;
+}
+
+JobHandle ShardedScheduler::addTask(const AsyncTask<>& task, const ScheduleParams& schedule){
+  return addTaskTo(_place(task._params), task, schedule);
+}
+
+JobHandle ShardedScheduler::addTask(AsyncTask<>&& task, const ScheduleParams& schedule){
+  size_t shard = _place(task._params);
+  return addTaskTo(shard, std::move(task), schedule);
+}
+
+JobHandle ShardedScheduler::addTask(InplaceFunction<void()> task, const ScheduleParams& schedule){
+  return addTask(AsyncTask<>(std::move(task)), schedule);
+}
+
+JobHandle ShardedScheduler::addTask(InplaceFunction<void()> task, const TaskParams& params, const ScheduleParams& schedule){
+  return addTask(AsyncTask<>(params, std::move(task)), schedule);
+}
+
+JobHandle ShardedScheduler::addTaskTo(size_t shard, const AsyncTask<>& task, const ScheduleParams& schedule){
+  if (shard >= _shards.size()){
+    return JobHandle();
+  }
+  JobHandle handle = _shards[shard]->addTask(task, schedule);
+  handle.shard = uint32_t(shard);
+  return handle;
+}
+
+JobHandle ShardedScheduler::addTaskTo(size_t shard, AsyncTask<>&& task, const ScheduleParams& schedule){
+  if (shard >= _shards.size()){
+    return JobHandle();
+  }
+  JobHandle handle = _shards[shard]->addTask(std::move(task), schedule);
+  handle.shard = uint32_t(shard);
+  return handle;
+}
+
+bool ShardedScheduler::contains(JobHandle handle){
+  Scheduler* shard = _shardOf(handle);
+  return shard && shard->contains(handle);
+}
+
+bool ShardedScheduler::remove(JobHandle handle){
+  Scheduler* shard = _shardOf(handle);
+  return shard && shard->remove(handle);
+}
+
+bool ShardedScheduler::reschedule(JobHandle handle, const ScheduleParams& schedule){
+  Scheduler* shard = _shardOf(handle);
+  return shard && shard->reschedule(handle, schedule);
+}
+
+bool ShardedScheduler::pause(JobHandle handle){
+  Scheduler* shard = _shardOf(handle);
+  return shard && shard->pause(handle);
+}
+
+bool ShardedScheduler::resume(JobHandle handle){
+  Scheduler* shard = _shardOf(handle);
+  return shard && shard->resume(handle);
+}
+
+bool ShardedScheduler::run(){
+  bool started = true;
+  for(auto& shard : _shards){
+    started = shard->run() && started;
+  }
+  return started;
+}
+
+void ShardedScheduler::execute(){
+  for(auto& shard : _shards){
+    shard->execute();
+  }
+}
+
+void ShardedScheduler::stop(){
+  for(auto& shard : _shards){
+    shard->stop();
+  }
+}
+
+void ShardedScheduler::pause(){
+  for(auto& shard : _shards){
+    shard->pause();
+  }
+}
+
+void ShardedScheduler::resume(){
+  for(auto& shard : _shards){
+    shard->resume();
+  }
+}
+
+size_t ShardedScheduler::shardCount() const{
+  return _shards.size();
+}
+
+Scheduler& ShardedScheduler::shard(size_t index){
+  return *_shards[index];
+}
+
+uint32_t ShardedScheduler::wakeups() const{
+  uint32_t total = 0;
+  for(const auto& shard : _shards){
+    total += shard->wakeups();
+  }
+  return total;
+}
+
+size_t ShardedScheduler::taskCount(){
+  size_t total = 0;
+  for(auto& shard : _shards){
+    total += shard->taskCount();
+  }
+  return total;
+}
+
+TaskStats ShardedScheduler::stats(JobHandle handle){
+  Scheduler* shard = _shardOf(handle);
+  return shard ? shard->stats(handle) : _TaskCounters().snapshot();
+}
+
+END_TASKS_NAMESPACE
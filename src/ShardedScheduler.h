@@ -0,0 +1,169 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "./Scheduler.h"
+
+BEGIN_TASKS_NAMESPACE
+
+/*
+
+## ShardedScheduler
+
+Several `Scheduler`s, one per core by default. Every shard has its own task, pinned
+to its core, its own lock and its own jobs, so the ticks of different shards run in
+parallel and a heavy tick on one core doesn't delay the jobs of the others.
+
+A job is placed on one shard when it's added and stays there: on a shard of its
+core if its `TaskParams` pin it to one, otherwise on the shard with the lowest
+firing rate (see `Scheduler::firingRate()`). The returned `JobHandle` remembers
+the shard, so `remove()`, `pause()`... only lock that one shard.
+
+
+### Example
+
+```cpp
+
+ShardedScheduler scheduler; // one shard per core
+
+// pinned to core 1, runs on the shard of core 1
+scheduler.addTask(readSensors, TaskParams().setUsePinnedCore(true).setCore(1),
+  ScheduleParams(10, TimeUnit::Milliseconds));
+// placed on the least loaded shard
+JobHandle report = scheduler.addTask(sendReport, ScheduleParams(1, TimeUnit::Minutes));
+
+scheduler.run();
+```
+*/
+class ShardedScheduler
+{
+  std::vector<std::unique_ptr<Scheduler>> _shards;
+
+  // shard for a new job with `params`
+  uint32_t _place(const TaskParams& params);
+
+  // the shard of `handle`, nullptr if there is no such shard
+  Scheduler* _shardOf(JobHandle handle);
+
+  public:
+  /**
+   * @brief Create the shards, they start with `run()`
+   * @param shards Number of shards, the task of shard `i` is pinned to core `i % portNUM_PROCESSORS`
+   * @param capacity Jobs every shard has room for, see `Scheduler::Scheduler()`
+  */
+  explicit ShardedScheduler(size_t shards = portNUM_PROCESSORS, size_t capacity = ASYNC_TASKS_SCHEDULER_CAPACITY);
+
+  ShardedScheduler(const ShardedScheduler&) = delete;
+  ShardedScheduler& operator=(const ShardedScheduler&) = delete;
+
+  /**
+   * @brief Set the parameters of the shards' tasks, `usePinnedCore` and `core` are ignored
+   * @return *this
+  */
+  ShardedScheduler& setParams(const TaskParams& params);
+
+  /**
+   * @brief Set the executor of all the shards, see `Scheduler::setExecutor()`
+   * @return *this
+  */
+  ShardedScheduler& setExecutor(Executor* executor);
+
+  /**
+   * @brief Add a task, on a shard of its core if it's pinned, otherwise on the least loaded shard
+   * @return Handle of the job
+  */
+  JobHandle addTask(const AsyncTask<>& task, const ScheduleParams& schedule);
+
+  JobHandle addTask(AsyncTask<>&& task, const ScheduleParams& schedule);
+
+  JobHandle addTask(InplaceFunction<void()> task, const ScheduleParams& schedule);
+
+  JobHandle addTask(InplaceFunction<void()> task, const TaskParams& params, const ScheduleParams& schedule);
+
+  /**
+   * @brief Add a task to the shard `shard`
+   * @return Handle of the job, invalid if there is no such shard
+  */
+  JobHandle addTaskTo(size_t shard, const AsyncTask<>& task, const ScheduleParams& schedule);
+
+  JobHandle addTaskTo(size_t shard, AsyncTask<>&& task, const ScheduleParams& schedule);
+
+  /**
+   * @brief See `Scheduler::contains()`
+  */
+  bool contains(JobHandle handle);
+
+  /**
+   * @brief See `Scheduler::remove()`
+  */
+  bool remove(JobHandle handle);
+
+  /**
+   * @brief See `Scheduler::reschedule()`, the job stays on its shard
+  */
+  bool reschedule(JobHandle handle, const ScheduleParams& schedule);
+
+  /**
+   * @brief See `Scheduler::pause(JobHandle)`
+  */
+  bool pause(JobHandle handle);
+
+  /**
+   * @brief See `Scheduler::resume(JobHandle)`
+  */
+  bool resume(JobHandle handle);
+
+  /**
+   * @brief Start the tasks of all the shards
+   * @return false if a shard couldn't start its task, see `Scheduler::run()`
+  */
+  bool run();
+
+  /**
+   * @brief Run one tick of every shard on the current task, see `Scheduler::execute()`
+  */
+  void execute();
+
+  /**
+   * @brief Stop all the shards, see `Scheduler::stop()`
+  */
+  void stop();
+
+  /**
+   * @brief Pause all the shards, see `Scheduler::pause()`
+  */
+  void pause();
+
+  /**
+   * @brief Resume all the shards, after `pause()`
+  */
+  void resume();
+
+  /**
+   * @brief Number of shards
+  */
+  size_t shardCount() const;
+
+  /**
+   * @brief The `Scheduler` of shard `index`
+  */
+  Scheduler& shard(size_t index);
+
+  /**
+   * @brief Sum of the wakeups of all the shards
+  */
+  uint32_t wakeups() const;
+
+  /**
+   * @brief Number of jobs on all the shards
+  */
+  size_t taskCount();
+
+  /**
+   * @brief Timing statistics of a job, empty if it was removed
+  */
+  TaskStats stats(JobHandle handle);
+};
+
+END_TASKS_NAMESPACE
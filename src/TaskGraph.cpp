@@ -0,0 +1,167 @@
+#include "TaskGraph.h"
+
+BEGIN_TASKS_NAMESPACE
+
+void TaskGraph::_runNode(void* param){
+  /*
+
+  Runs a node, then releases its successors. The first successor that becomes
+  ready runs right here, on the same worker, the others are submitted to the
+  executor, so the other workers can pick them up.
+
+  */
+  _Node* node = static_cast<_Node*>(param);
+  TaskGraph* graph = node->graph;
+
+  while(node){
+    if (node->fn){
+      node->fn();
+    }
+
+    _Node* next = nullptr;
+    for(size_t id : node->successors){
+      _Node& successor = graph->_nodes[id];
+      if (!successor._release()){
+        continue;
+      }
+      if (!next){
+        next = &successor;
+      } else {
+        graph->_start(successor);
+      }
+    }
+
+    // `next` isn't finished yet, so this can't be the last node, and the graph
+    // stays valid. Without `next`, the graph must not be touched after this
+    graph->_finish();
+    node = next;
+  }
+}
+
+void TaskGraph::_finish(){
+  if (_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1){
+    xSemaphoreGive(_done);
+  }
+}
+
+void TaskGraph::_start(_Node& node){
+  if (!_executor->submit(_runNode, &node)){
+    _runNode(&node);
+  }
+}
+
+size_t TaskGraph::_addNode(InplaceFunction<void()>&& fn, bool any){
+  _nodes.emplace_back(this, std::move(fn), any);
+  _roots.push_back(_nodes.size() - 1);
+  return _nodes.size() - 1;
+}
+
+void TaskGraph::_addEdge(size_t from, size_t to){
+  _nodes[from].successors.push_back(to);
+  if (_nodes[to].dependencies++ == 0){
+    // not a root anymore, it's usually the node just added, at the back
+    for(size_t i = _roots.size(); i-- > 0;){
+      if (_roots[i] == to){
+        _roots.erase(_roots.begin() + i);
+        break;
+      }
+    }
+  }
+}
+
+TaskGraph::Node TaskGraph::Node::then(InplaceFunction<void()> fn){
+  size_t id = _graph->_addNode(std::move(fn), false);
+  _graph->_addEdge(_id, id);
+  return Node(_graph, id);
+}
+
+size_t TaskGraph::Node::id() const{
+  return _id;
+}
+
+TaskGraph::TaskGraph():
+  _nodes(), _roots(), _executor(nullptr), _remaining(0), _done(xSemaphoreCreateBinary())
+{
+  xSemaphoreGive(_done);
+}
+
+TaskGraph::~TaskGraph(){
+  wait();
+  vSemaphoreDelete(_done);
+}
+
+TaskGraph::Node TaskGraph::add(InplaceFunction<void()> fn){
+  return Node(this, _addNode(std::move(fn), false));
+}
+
+TaskGraph::Node TaskGraph::whenAll(std::initializer_list<Node> dependencies, InplaceFunction<void()> fn){
+  size_t id = _addNode(std::move(fn), false);
+  for(const Node& dependency : dependencies){
+    _addEdge(dependency._id, id);
+  }
+  return Node(this, id);
+}
+
+TaskGraph::Node TaskGraph::whenAny(std::initializer_list<Node> dependencies, InplaceFunction<void()> fn){
+  size_t id = _addNode(std::move(fn), true);
+  for(const Node& dependency : dependencies){
+    _addEdge(dependency._id, id);
+  }
+  return Node(this, id);
+}
+
+bool TaskGraph::run(Executor& executor){
+  // `_done` is taken for the whole run
+  if (xSemaphoreTake(_done, 0) != pdTRUE){
+    return false;
+  }
+  if (_nodes.empty()){
+    xSemaphoreGive(_done);
+    return true;
+  }
+
+  _executor = &executor;
+  for(_Node& node : _nodes){
+    // a `whenAny` node starts on the first release, the later ones take the counter below 0
+    int32_t pending = node.any && node.dependencies > 0 ? 1 : node.dependencies;
+    node.pending.store(pending, std::memory_order_relaxed);
+  }
+  _remaining.store(_nodes.size(), std::memory_order_release);
+
+  // the nodes may finish (and the graph be destroyed) while starting the last root,
+  // the loop must not read the graph after it, so it ends on local copies
+  const size_t* roots = _roots.data();
+  size_t count = _roots.size();
+  for(size_t i = 0; i < count; i++){
+    _start(_nodes[roots[i]]);
+  }
+  return true;
+}
+
+void TaskGraph::wait(){
+  waitFor(portMAX_DELAY);
+}
+
+bool TaskGraph::waitFor(uint32_t timeout){
+  TickType_t ticks = timeout == portMAX_DELAY ? portMAX_DELAY : pdMS_TO_TICKS(timeout);
+  if (xSemaphoreTake(_done, ticks) != pdTRUE){
+    return false;
+  }
+  xSemaphoreGive(_done);
+  return true;
+}
+
+bool TaskGraph::done() const{
+  return _remaining.load(std::memory_order_acquire) == 0;
+}
+
+size_t TaskGraph::size() const{
+  return _nodes.size();
+}
+
+void TaskGraph::clear(){
+  _nodes.clear();
+  _roots.clear();
+}
+
+END_TASKS_NAMESPACE
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <initializer_list>
+#include <vector>
+
+#include "./AsyncTask.h"
+#include "./Executor.h"
+#include "./inplace_function.h"
+
+BEGIN_TASKS_NAMESPACE
+
+/*
+
+## TaskGraph
+
+A set of jobs with dependencies between them (a directed acyclic graph), run on an
+executor. A node is started when its dependencies are done: every node has an atomic
+counter of unfinished dependencies, the worker finishing the last one starts it, there
+is no polling and no mutex. Independent branches run in parallel on all the executor's
+workers (use a `WorkStealingExecutor`), and the worker that finished a node runs its
+first ready successor itself, so the data stays in that core's cache.
+
+Nodes are added with `add()` (no dependencies), `then()` (after one node), `whenAll()`
+(after all of the given nodes) and `whenAny()` (after the first of the given nodes).
+Every node is created after its dependencies, so the graph can't have cycles.
+The graph can be run many times, but must not be changed while it's running.
+
+
+### Example
+
+```cpp
+
+WorkStealingExecutor executor;
+TaskGraph graph;
+
+auto read = graph.add([](){ readSensors(); });
+auto accel = read.then([](){ filterAccelerometer(); });
+auto gyro = read.then([](){ filterGyroscope(); });
+graph.whenAll({accel, gyro}, [](){ fuse(); });
+
+executor.run();
+graph.run(executor);
+graph.wait();
+```
+*/
+class TaskGraph
+{
+  struct _Node{
+    TaskGraph* graph;
+    InplaceFunction<void()> fn;
+    // nodes started after this one
+    std::vector<size_t> successors;
+    // number of dependencies
+    int32_t dependencies;
+    // true if the node starts after the first of its dependencies, not after all of them
+    bool any;
+    // dependencies left to finish in the current run, the node starts when it drops to 0
+    std::atomic<int32_t> pending;
+
+    _Node(TaskGraph* graph, InplaceFunction<void()>&& fn, bool any):
+      graph(graph), fn(std::move(fn)), successors(), dependencies(0), any(any), pending(0) {}
+
+    // mark one dependency as done, true if the node is ready to run
+    bool _release(){
+      return pending.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+  };
+
+  std::deque<_Node> _nodes;
+  // ids of the nodes without dependencies, kept up to date while the graph is built,
+  // so `run()` doesn't collect them
+  std::vector<size_t> _roots;
+  Executor* _executor;
+  // nodes left to finish in the current run
+  std::atomic<size_t> _remaining;
+  // given when the graph isn't running
+  SemaphoreHandle_t _done;
+
+  // job function running a node, and the ready successors
+  static void _runNode(void* param);
+
+  // count a node as finished, gives `_done` after the last one
+  void _finish();
+
+  // start the node on the executor, or on the calling task if the executor is full
+  void _start(_Node& node);
+
+  size_t _addNode(InplaceFunction<void()>&& fn, bool any);
+  void _addEdge(size_t from, size_t to);
+
+  public:
+  /**
+   * Handle to a node of a `TaskGraph`
+  */
+  class Node{
+    friend class TaskGraph;
+
+    TaskGraph* _graph;
+    size_t _id;
+
+    Node(TaskGraph* graph, size_t id): _graph(graph), _id(id) {}
+
+    public:
+    /**
+     * @brief Add a node, started after this one
+     * @return The new node
+    */
+    Node then(InplaceFunction<void()> fn);
+
+    /**
+     * @brief Index of the node in the graph, in the order of creation
+    */
+    size_t id() const;
+  };
+
+  TaskGraph();
+  ~TaskGraph();
+
+  TaskGraph(const TaskGraph&) = delete;
+  TaskGraph& operator=(const TaskGraph&) = delete;
+
+  /**
+   * @brief Add a node without dependencies, started as soon as the graph runs
+   * @return The new node
+  */
+  Node add(InplaceFunction<void()> fn);
+
+  /**
+   * @brief Add a node, started after all of the given nodes are done
+   * @return The new node
+  */
+  Node whenAll(std::initializer_list<Node> dependencies, InplaceFunction<void()> fn);
+
+  /**
+   * @brief Add a node, started after the first of the given nodes is done,
+   * the others may still be running
+   * @return The new node
+  */
+  Node whenAny(std::initializer_list<Node> dependencies, InplaceFunction<void()> fn);
+
+  /**
+   * @brief Start the graph on the executor, returns right away.
+   * If the executor is full, the node runs on the task that started it
+   * @return false if the graph is still running
+  */
+  bool run(Executor& executor);
+
+  /**
+   * @brief Block until all the nodes are done
+  */
+  void wait();
+
+  /**
+   * @brief Block until all the nodes are done, or the timeout passes
+   * @param timeout Maximum time to wait in milliseconds
+   * @return true if the graph is done
+  */
+  bool waitFor(uint32_t timeout);
+
+  /**
+   * @brief Check if the graph isn't running, doesn't block
+  */
+  bool done() const;
+
+  /**
+   * @brief Number of nodes
+  */
+  size_t size() const;
+
+  /**
+   * @brief Remove all the nodes, must not be called while the graph is running
+  */
+  void clear();
+};
+
+END_TASKS_NAMESPACE
@@ -0,0 +1,143 @@
+#include "TaskPool.h"
+
+#include <algorithm>
+
+BEGIN_TASKS_NAMESPACE
+
+void TaskPool::_workerLoop(void* param){
+  /*
+
+  Main loop of a worker task.
+
+  Waits for jobs on the shared queue and runs them one after another, a job
+  without a function is the signal to exit.
+
+  */
+  TaskPool* pool = static_cast<TaskPool*>(param);
+  _Job job;
+
+  for(;;){
+    if (xSemaphoreTake(pool->_available, portMAX_DELAY) != pdTRUE){
+      continue;
+    }
+    pool->_takeJob(job);
+    if (!job.fn){
+      break;
+    }
+    job.fn(job.arg);
+  }
+
+  // the pool might be destroyed right after this, don't touch it anymore
+  xSemaphoreGive(pool->_exited);
+  BaseAsyncTask::_exitTask();
+}
+
+void TaskPool::_takeJob(_Job& job){
+  // The job is counted only after it's in the queue, but a producer preempted between
+  // reserving its slot and filling it (by an interrupt, or a higher priority task
+  // submitting after it) hides the jobs queued behind it, until it's running again.
+  // Sleep until a submit fills a slot, that producer's one included
+  while(!_queue.pop(job)){
+    int slot = _stalled._add();
+    // a slot filled between the pop and `_add()` didn't wake us up, check again
+    if (_queue.pop(job)){
+      _stalled._remove(slot, false);
+      return;
+    }
+    _stalled._sleep(slot, portMAX_DELAY);
+  }
+}
+
+void TaskPool::_wakeStalled(){
+  // all of them, each one holds the count of a different job, cheap when none is waiting
+  _stalled._wakeAll();
+}
+
+TaskPool::TaskPool(size_t workers, size_t queueSize):
+  _queue(queueSize),
+  _available(xSemaphoreCreateCounting(_queue.capacity() + workers, 0)),
+  _exited(xSemaphoreCreateCounting(workers, 0)),
+  _workers(), _workerCount(workers),
+  _params(4096, tskIDLE_PRIORITY, "Pool") {}
+
+TaskPool::~TaskPool(){
+  stop();
+  vSemaphoreDelete(_available);
+  vSemaphoreDelete(_exited);
+}
+
+TaskPool& TaskPool::setParams(const TaskParams& params){
+  _params = params;
+  return *this;
+}
+
+void TaskPool::run(){
+  // if the pool is already running, return
+  if (!_workers.empty()){
+    return;
+  }
+
+  _workers.resize(_workerCount, NULL);
+  for(size_t i = 0; i < _workerCount; i++){
+    _workers[i] = BaseAsyncTask::_createTask(
+      _workerLoop, _params.name, _params.stackSize, this, _params.priority, _params
+    );
+  }
+
+  // keep only the workers that were actually created, `stop()` waits for each of them
+  _workers.erase(std::remove(_workers.begin(), _workers.end(), (TaskHandle_t)NULL), _workers.end());
+}
+
+void TaskPool::stop(){
+  if (_workers.empty()){
+    return;
+  }
+
+  // one exit job for every worker, queued after the pending jobs
+  _Job exit = {nullptr, nullptr};
+  for(size_t i = 0; i < _workers.size(); i++){
+    while(!_queue.push(exit)){
+      vTaskDelay(1);
+    }
+    xSemaphoreGive(_available);
+    _wakeStalled();
+  }
+  for(size_t i = 0; i < _workers.size(); i++){
+    xSemaphoreTake(_exited, portMAX_DELAY);
+  }
+  _workers.clear();
+}
+
+bool TaskPool::submit(_JobFunction fn, void* arg){
+  if (!fn){
+    return false;
+  }
+  _Job job = {fn, arg};
+  if (!_queue.push(job)){
+    return false;
+  }
+  xSemaphoreGive(_available);
+  _wakeStalled();
+  return true;
+}
+
+bool TaskPool::submitFromISR(_JobFunction fn, void* arg){
+  if (!fn){
+    return false;
+  }
+  _Job job = {fn, arg};
+  if (!_queue.push(job)){
+    return false;
+  }
+  BaseType_t woken = pdFALSE;
+  xSemaphoreGiveFromISR(_available, &woken);
+  _stalled._wakeAllFromISR(&woken);
+  portYIELD_FROM_ISR(woken);
+  return true;
+}
+
+size_t TaskPool::workers() const{
+  return _workers.size();
+}
+
+END_TASKS_NAMESPACE
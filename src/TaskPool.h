@@ -0,0 +1,116 @@
+#pragma once
+
+#include <vector>
+
+#include "./AsyncTask.h"
+#include "./Executor.h"
+#include "./mpmc_queue.h"
+#include "./waiters.h"
+
+BEGIN_TASKS_NAMESPACE
+
+/*
+
+## TaskPool
+
+A fixed set of long-lived worker tasks, fed by a lock-free queue. Submitting a job
+only copies two pointers into the queue and gives a counting semaphore, so there is no
+task creation, stack allocation or idle-task cleanup for every `AsyncTask::run()`.
+Jobs can also be submitted from interrupt handlers, with `submitFromISR()`.
+
+
+### Example
+
+```cpp
+
+TaskPool pool(2, 32);
+pool.run();
+
+// `run()` will now submit the task to the pool, instead of creating a new FreeRTOS task
+AsyncTask<int> task(TaskParams().setExecutor(&pool), [](int i){
+  Serial.println("Running on a pool worker: " + String(i));
+});
+task(5);
+```
+*/
+class TaskPool : public Executor
+{
+  struct _Job{
+    _JobFunction fn;
+    void* arg;
+  };
+
+  // preallocated job slots, safe to push to from interrupts
+  _MpmcQueue<_Job> _queue;
+  // number of queued jobs, the workers block on it
+  SemaphoreHandle_t _available;
+  // workers that took a job from `_available` but found it hidden behind a slot still
+  // being filled, woken by the next submit, more of them than `ASYNC_TASKS_WAITERS`
+  // check the queue every tick
+  _TaskWaiters _stalled;
+  // given by each worker when it exits, used by `stop()` to wait for the workers
+  SemaphoreHandle_t _exited;
+  std::vector<TaskHandle_t> _workers;
+  size_t _workerCount;
+  TaskParams _params;
+
+  // main loop of the worker tasks
+  static void _workerLoop(void* param);
+
+  // take a job, the semaphore guarantees there is one, blocks while it's hidden
+  void _takeJob(_Job& job);
+
+  // wake the workers waiting in `_takeJob()`, after a job was queued
+  void _wakeStalled();
+
+  public:
+  /**
+   * @brief Create a new task pool, the workers are started with `run()`
+   * @param workers Number of worker tasks
+   * @param queueSize Maximum number of jobs waiting for a free worker, rounded up to a power of 2
+  */
+  TaskPool(size_t workers = 2, size_t queueSize = 32);
+  ~TaskPool();
+
+  TaskPool(const TaskPool&) = delete;
+  TaskPool& operator=(const TaskPool&) = delete;
+
+  /**
+   * @brief Set the parameters of the worker tasks, must be called before `run()`
+   * @param params The parameters to be set
+   * @return *this
+  */
+  TaskPool& setParams(const TaskParams& params);
+
+  /**
+   * @brief Start the worker tasks, jobs submitted before are executed right away
+  */
+  void run();
+
+  /**
+   * @brief Stop the workers, after they finish the already queued jobs.
+   * Must not be called from a job running on this pool
+  */
+  void stop();
+
+  /**
+   * @brief Queue a job, doesn't block if the queue is full
+   * @return true if the job was queued, false if the queue is full
+  */
+  bool submit(_JobFunction fn, void* arg) override;
+
+  /**
+   * @brief Queue a job from an interrupt handler, a waiting worker starts right
+   * after the handler returns, if it has a higher priority than the interrupted task
+   * @return true if the job was queued, false if the queue is full
+  */
+  bool submitFromISR(_JobFunction fn, void* arg) override;
+
+  /**
+   * @brief Number of worker tasks running, fewer than requested if some couldn't
+   * be created (out of memory, or no stack left in static mode), 0 before `run()`
+  */
+  size_t workers() const;
+};
+
+END_TASKS_NAMESPACE
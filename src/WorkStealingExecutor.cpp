@@ -0,0 +1,239 @@
+#include "WorkStealingExecutor.h"
+
+BEGIN_TASKS_NAMESPACE
+
+void WorkStealingExecutor::_workerLoop(void* param){
+  /*
+
+  Main loop of a worker task.
+
+  Runs jobs from its own deque first, then from its inbox, and steals from the
+  other workers when it has nothing to do. When there is no job anywhere, the worker
+  sleeps until it's notified by `submit()` or `stop()`.
+
+  */
+  _Worker* self = static_cast<_Worker*>(param);
+  WorkStealingExecutor* executor = self->executor;
+  _Job job;
+
+  // published before the worker can sleep, `run()` might not have stored it yet, and
+  // `_wake()` skips a worker without a handle
+  self->handle.store(xTaskGetCurrentTaskHandle());
+
+  for(;;){
+    if (executor->_findJob(*self, job)){
+      job.fn(job.arg);
+      continue;
+    }
+    if (executor->_stopping.load()){
+      break;
+    }
+
+    // announce the sleep before the last check, `submit()` pushes first and then
+    // checks `sleeping`, so either we see the job or the submitter sees us sleeping
+    self->sleeping.store(true);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (executor->_hasWork() || executor->_stopping.load()){
+      self->sleeping.store(false);
+      continue;
+    }
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    self->sleeping.store(false);
+  }
+
+  // the executor might be destroyed right after this, don't touch it anymore
+  xSemaphoreGive(executor->_exited);
+  BaseAsyncTask::_exitTask();
+}
+
+bool WorkStealingExecutor::_findJob(_Worker& self, _Job& job){
+  if (self.deque.pop(job.fn, job.arg) || self.inbox.pop(job)){
+    return true;
+  }
+
+  // steal, starting from the next worker, so the victims are spread evenly
+  size_t count = _workers.size();
+  for(size_t i = 1; i < count; i++){
+    _Worker& victim = *_workers[(self.index + i) % count];
+    if (victim.deque.steal(job.fn, job.arg) || victim.inbox.pop(job)){
+      return true;
+    }
+  }
+  return false;
+}
+
+bool WorkStealingExecutor::_hasWork() const{
+  // Only jobs `_findJob()` can take, a producer preempted between reserving an inbox
+  // slot and filling it hides that slot (and the ones after it), a worker that saw it as
+  // work would spin on it, and starve the producer if it runs on the same core.
+  // The worker sleeps instead, the producer wakes a worker after filling the slot
+  for(auto& worker : _workers){
+    if (!worker->deque.empty() || worker->inbox.ready()){
+      return true;
+    }
+  }
+  return false;
+}
+
+WorkStealingExecutor::_Worker* WorkStealingExecutor::_currentWorker() const{
+  TaskHandle_t current = xTaskGetCurrentTaskHandle();
+  for(auto& worker : _workers){
+    if (worker->handle.load() == current){
+      return worker.get();
+    }
+  }
+  return nullptr;
+}
+
+void WorkStealingExecutor::_wake(_Worker& worker){
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  TaskHandle_t handle = worker.handle.load();
+  if (worker.sleeping.load() && handle){
+    xTaskNotifyGive(handle);
+    return;
+  }
+  // the chosen worker is busy, wake an idle one, so it can steal the job
+  for(auto& other : _workers){
+    handle = other->handle.load();
+    if (other->sleeping.load() && handle){
+      xTaskNotifyGive(handle);
+      return;
+    }
+  }
+}
+
+void WorkStealingExecutor::_wakeFromISR(_Worker& worker, BaseType_t* woken){
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  TaskHandle_t handle = worker.handle.load();
+  if (worker.sleeping.load() && handle){
+    vTaskNotifyGiveFromISR(handle, woken);
+    return;
+  }
+  for(auto& other : _workers){
+    handle = other->handle.load();
+    if (other->sleeping.load() && handle){
+      vTaskNotifyGiveFromISR(handle, woken);
+      return;
+    }
+  }
+}
+
+WorkStealingExecutor::WorkStealingExecutor(size_t workers, size_t capacity):
+  _workers(), _next(0), _stopping(false),
+  _exited(xSemaphoreCreateCounting(workers ? workers : 1, 0)),
+  _params(4096, tskIDLE_PRIORITY, "Worker"), _running(false)
+{
+  if (workers == 0){
+    workers = 1;
+  }
+  _workers.reserve(workers);
+  for(size_t i = 0; i < workers; i++){
+    _workers.emplace_back(new _Worker(this, i, capacity));
+  }
+}
+
+WorkStealingExecutor::~WorkStealingExecutor(){
+  stop();
+  vSemaphoreDelete(_exited);
+}
+
+WorkStealingExecutor& WorkStealingExecutor::setParams(const TaskParams& params){
+  _params = params;
+  return *this;
+}
+
+void WorkStealingExecutor::run(){
+  // if the executor is already running, return
+  if (_running){
+    return;
+  }
+  _running = true;
+  _stopping.store(false);
+
+  TaskParams pinned = _params;
+  pinned.setUsePinnedCore(true);
+  for(auto& worker : _workers){
+    pinned.setCore(int(worker->index % portNUM_PROCESSORS));
+    TaskHandle_t handle = BaseAsyncTask::_createTask(
+      _workerLoop, _params.name, _params.stackSize, worker.get(), _params.priority, pinned
+    );
+    // the worker publishes it too, this one is for `stop()`, which waits for the
+    // workers that were created, also if they didn't start yet
+    worker->handle.store(handle);
+  }
+}
+
+void WorkStealingExecutor::stop(){
+  if (!_running){
+    return;
+  }
+
+  _stopping.store(true);
+  size_t started = 0;
+  for(auto& worker : _workers){
+    TaskHandle_t handle = worker->handle.load();
+    if (handle){
+      xTaskNotifyGive(handle);
+      started++;
+    }
+  }
+  for(size_t i = 0; i < started; i++){
+    xSemaphoreTake(_exited, portMAX_DELAY);
+  }
+  for(auto& worker : _workers){
+    worker->handle.store(NULL);
+  }
+  _running = false;
+}
+
+bool WorkStealingExecutor::submit(_JobFunction fn, void* arg){
+  if (!fn){
+    return false;
+  }
+
+  // submitted by one of our workers, keep it local, no atomic read-modify-write needed
+  _Worker* current = _currentWorker();
+  if (current && current->deque.push(fn, arg)){
+    _wake(*current);
+    return true;
+  }
+
+  _Job job = {fn, arg};
+  size_t count = _workers.size();
+  size_t start = _next.fetch_add(1, std::memory_order_relaxed);
+  for(size_t i = 0; i < count; i++){
+    _Worker& worker = *_workers[(start + i) % count];
+    if (worker.inbox.push(job)){
+      _wake(worker);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool WorkStealingExecutor::submitFromISR(_JobFunction fn, void* arg){
+  if (!fn){
+    return false;
+  }
+
+  // an interrupt never runs on a worker's deque, always use the inboxes
+  _Job job = {fn, arg};
+  size_t count = _workers.size();
+  size_t start = _next.fetch_add(1, std::memory_order_relaxed);
+  for(size_t i = 0; i < count; i++){
+    _Worker& worker = *_workers[(start + i) % count];
+    if (worker.inbox.push(job)){
+      BaseType_t woken = pdFALSE;
+      _wakeFromISR(worker, &woken);
+      portYIELD_FROM_ISR(woken);
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t WorkStealingExecutor::workers() const{
+  return _workers.size();
+}
+
+END_TASKS_NAMESPACE
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "./AsyncTask.h"
+#include "./Executor.h"
+#include "./mpmc_queue.h"
+#include "./work_deque.h"
+
+BEGIN_TASKS_NAMESPACE
+
+/*
+
+## WorkStealingExecutor
+
+One worker task pinned to each core, every worker with its own lock-free deque.
+Jobs submitted from a worker (for example a job starting another `AsyncTask`) go to
+that worker's deque, jobs submitted from other tasks are spread round-robin over the
+workers' inboxes. An idle worker steals from the busy ones, so a burst of submissions
+is balanced over all cores, without a central mutex. Interrupt handlers can submit
+jobs with `submitFromISR()`, into the same lock-free inboxes.
+
+
+### Example
+
+```cpp
+
+WorkStealingExecutor executor; // one worker per core
+executor.run();
+
+for (int i = 0; i < 100; i++){
+  AsyncTask<int> task(TaskParams().setExecutor(&executor), [](int i){
+    Serial.println("Job " + String(i) + " on core " + String(xPortGetCoreID()));
+  });
+  task(i);
+}
+```
+*/
+class WorkStealingExecutor : public Executor
+{
+  struct _Job{
+    _JobFunction fn;
+    void* arg;
+  };
+
+  struct _Worker{
+    WorkStealingExecutor* executor;
+    size_t index;
+    std::atomic<TaskHandle_t> handle;
+    // local jobs, only pushed and popped by this worker, stolen by the others
+    _WorkDeque deque;
+    // jobs submitted from outside of the executor
+    _MpmcQueue<_Job> inbox;
+    // set while the worker is blocked waiting for a notification
+    std::atomic<bool> sleeping;
+
+    _Worker(WorkStealingExecutor* executor, size_t index, size_t capacity):
+      executor(executor), index(index), handle(NULL),
+      deque(capacity), inbox(capacity), sleeping(false) {}
+  };
+
+  std::vector<std::unique_ptr<_Worker>> _workers;
+  std::atomic<uint32_t> _next;
+  std::atomic<bool> _stopping;
+  // given by each worker when it exits, used by `stop()` to wait for the workers
+  SemaphoreHandle_t _exited;
+  TaskParams _params;
+  bool _running;
+
+  // main loop of the worker tasks
+  static void _workerLoop(void* param);
+
+  // get a job from the own deque, the own inbox, or steal it from the others
+  bool _findJob(_Worker& self, _Job& job);
+
+  // check if any worker has a job waiting, that can be taken right now
+  bool _hasWork() const;
+
+  // the worker running on the current task, or nullptr if called from outside
+  _Worker* _currentWorker() const;
+
+  // wake `worker` if it's sleeping, otherwise any other sleeping worker
+  void _wake(_Worker& worker);
+
+  // `_wake()` for interrupt handlers, sets `woken` if a higher priority task was woken
+  void _wakeFromISR(_Worker& worker, BaseType_t* woken);
+
+  public:
+  /**
+   * @brief Create a new executor, the workers are started with `run()`
+   * @param workers Number of worker tasks, worker `i` is pinned to core `i % portNUM_PROCESSORS`
+   * @param capacity Maximum number of jobs in each worker's deque and inbox
+  */
+  WorkStealingExecutor(size_t workers = portNUM_PROCESSORS, size_t capacity = 64);
+  ~WorkStealingExecutor();
+
+  WorkStealingExecutor(const WorkStealingExecutor&) = delete;
+  WorkStealingExecutor& operator=(const WorkStealingExecutor&) = delete;
+
+  /**
+   * @brief Set the parameters of the worker tasks (stack size, priority, name),
+   * must be called before `run()`, `usePinnedCore` and `core` are ignored
+   * @return *this
+  */
+  WorkStealingExecutor& setParams(const TaskParams& params);
+
+  /**
+   * @brief Start the worker tasks
+  */
+  void run();
+
+  /**
+   * @brief Stop the workers, after they finish all the submitted jobs.
+   * Must not be called from a job running on this executor
+  */
+  void stop();
+
+  /**
+   * @brief Submit a job, never blocks and never takes a lock
+   * @return false if all the deques or inboxes are full
+  */
+  bool submit(_JobFunction fn, void* arg) override;
+
+  /**
+   * @brief Submit a job from an interrupt handler, never blocks and never takes a lock,
+   * a sleeping worker starts right after the handler returns
+   * @return false if all the inboxes are full
+  */
+  bool submitFromISR(_JobFunction fn, void* arg) override;
+
+  /**
+   * @brief Number of worker tasks
+  */
+  size_t workers() const;
+};
+
+END_TASKS_NAMESPACE
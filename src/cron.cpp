@@ -0,0 +1,355 @@
+#include "cron.h"
+
+#include <string.h>
+
+BEGIN_TASKS_NAMESPACE
+BEGIN_CRON_NAMESPACE
+
+namespace {
+
+// a year may match only once in 28 (Feb 29 on a given weekday)
+const int _searchYears = 28;
+
+const char* const _monthNames[] = {
+  "JAN", "FEB", "MAR", "APR", "MAY", "JUN", "JUL", "AUG", "SEP", "OCT", "NOV", "DEC"
+};
+const char* const _weekdayNames[] = {
+  "SUN", "MON", "TUE", "WED", "THU", "FRI", "SAT"
+};
+
+struct _Field{
+  int min;
+  int max;
+  // names of the values from `min`, or NULL
+  const char* const* names;
+  int nameCount;
+};
+
+const _Field _fields[] = {
+  {0, 59, NULL, 0},
+  {0, 23, NULL, 0},
+  {1, 31, NULL, 0},
+  {1, 12, _monthNames, 12},
+  // 7 is Sunday too, folded into bit 0 after parsing
+  {0, 7, _weekdayNames, 7},
+};
+
+struct _Shortcut{
+  const char* name;
+  const char* expression;
+};
+
+const _Shortcut _shortcuts[] = {
+  {"@yearly", "0 0 1 1 *"},
+  {"@annually", "0 0 1 1 *"},
+  {"@monthly", "0 0 1 * *"},
+  {"@weekly", "0 0 * * 0"},
+  {"@daily", "0 0 * * *"},
+  {"@midnight", "0 0 * * *"},
+  {"@hourly", "0 * * * *"},
+};
+
+bool _isSpace(char c){
+  return c == ' ' || c == '\t';
+}
+
+char _upper(char c){
+  return (c >= 'a' && c <= 'z') ? char(c - 'a' + 'A') : c;
+}
+
+bool _parseValue(const char*& p, const _Field& field, int& value){
+  if (*p >= '0' && *p <= '9'){
+    value = 0;
+    while (*p >= '0' && *p <= '9'){
+      value = value * 10 + (*p++ - '0');
+      if (value > field.max){
+        return false;
+      }
+    }
+    return value >= field.min;
+  }
+  for (int i = 0; i < field.nameCount; i++){
+    const char* name = field.names[i];
+    if (_upper(p[0]) == name[0] && _upper(p[1]) == name[1] && _upper(p[2]) == name[2]){
+      p += 3;
+      value = field.min + i;
+      return true;
+    }
+  }
+  return false;
+}
+
+// parse one field into `bits`, `star` is set if it starts with `*`
+bool _parseField(const char*& p, const _Field& field, uint64_t& bits, bool& star){
+  bits = 0;
+  star = *p == '*';
+  for (;;){
+    int first, last;
+    bool single = false;
+    if (*p == '*'){
+      p++;
+      first = field.min;
+      last = field.max;
+    } else {
+      if (!_parseValue(p, field, first)){
+        return false;
+      }
+      last = first;
+      single = *p != '-';
+      if (*p == '-'){
+        p++;
+        if (!_parseValue(p, field, last) || last < first){
+          return false;
+        }
+      }
+    }
+
+    int step = 1;
+    if (*p == '/'){
+      p++;
+      if (!(*p >= '0' && *p <= '9')){
+        return false;
+      }
+      step = 0;
+      while (*p >= '0' && *p <= '9'){
+        step = step * 10 + (*p++ - '0');
+        if (step > field.max + 1){
+          return false;
+        }
+      }
+      if (step == 0){
+        return false;
+      }
+      // `5/15` means from 5 to the end
+      if (single){
+        last = field.max;
+      }
+    }
+
+    for (int value = first; value <= last; value += step){
+      bits |= uint64_t(1) << value;
+    }
+
+    if (*p != ','){
+      break;
+    }
+    p++;
+  }
+  return *p == '\0' || _isSpace(*p);
+}
+
+// `mask` without the bits below `bit`
+inline uint32_t _from(uint32_t mask, int bit){
+  return bit >= 32 ? 0 : mask & (~uint32_t(0) << bit);
+}
+
+inline uint64_t _from(uint64_t mask, int bit){
+  return bit >= 64 ? 0 : mask & (~uint64_t(0) << bit);
+}
+
+inline int _lowest(uint32_t mask){
+  return __builtin_ctz(mask);
+}
+
+inline int _lowest(uint64_t mask){
+  return __builtin_ctzll(mask);
+}
+
+bool _isLeap(int year){
+  return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+int _daysInMonth(int year, int month){
+  static const uint8_t days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  return month == 2 && _isLeap(year) ? 29 : days[month - 1];
+}
+
+// day of the week, 0 is Sunday, month 1-12
+int _weekday(int year, int month, int day){
+  static const uint8_t offsets[] = {0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4};
+  if (month < 3){
+    year--;
+  }
+  return (year + year / 4 - year / 100 + year / 400 + offsets[month - 1] + day) % 7;
+}
+
+int _dayOfYear(int year, int month, int day){
+  static const uint16_t before[] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+  return before[month - 1] + day - 1 + (month > 2 && _isLeap(year) ? 1 : 0);
+}
+
+}
+
+Expression::Expression():
+  _minutes(0), _hours(0), _days(0), _months(0), _weekdays(0), _flags(0) {}
+
+Expression::Expression(const char* text): Expression(){
+  if (text && _parse(text)){
+    _flags |= _Valid;
+  } else {
+    *this = Expression();
+  }
+}
+
+bool Expression::_parse(const char* text){
+  while (_isSpace(*text)){
+    text++;
+  }
+  if (*text == '@'){
+    for (const _Shortcut& shortcut : _shortcuts){
+      size_t length = strlen(shortcut.name);
+      if (strncmp(text, shortcut.name, length) == 0 && (text[length] == '\0' || _isSpace(text[length]))){
+        return _parse(shortcut.expression);
+      }
+    }
+    return false;
+  }
+
+  uint64_t bits[5];
+  bool star[5];
+  for (int i = 0; i < 5; i++){
+    while (_isSpace(*text)){
+      text++;
+    }
+    if (*text == '\0' || !_parseField(text, _fields[i], bits[i], star[i])){
+      return false;
+    }
+  }
+  while (_isSpace(*text)){
+    text++;
+  }
+  if (*text != '\0'){
+    return false;
+  }
+
+  _minutes = bits[0];
+  _hours = uint32_t(bits[1]);
+  _days = uint32_t(bits[2]);
+  _months = uint16_t(bits[3]);
+  _weekdays = uint8_t((bits[4] | (bits[4] >> 7)) & 0x7f);
+  _flags = uint8_t((star[2] ? _DaysStar : 0) | (star[4] ? _WeekdaysStar : 0));
+  return true;
+}
+
+uint32_t Expression::_daysOf(int year, int month) const{
+  int length = _daysInMonth(year, month);
+  uint32_t inMonth = uint32_t((uint64_t(1) << (length + 1)) - 2);
+
+  // rotate the weekdays so bit 0 is the weekday of the 1st, and repeat them over the month
+  int first = _weekday(year, month, 1);
+  uint32_t week = ((uint32_t(_weekdays) >> first) | (uint32_t(_weekdays) << (7 - first))) & 0x7f;
+  uint32_t weekdays = (week | (week << 7) | (week << 14) | (week << 21) | (week << 28)) << 1;
+
+  uint32_t days;
+  if (_flags & _DaysStar){
+    days = weekdays;
+  } else if (_flags & _WeekdaysStar){
+    days = _days;
+  } else {
+    days = _days | weekdays;
+  }
+  return days & inMonth;
+}
+
+bool Expression::matches(const struct tm& time) const{
+  if (!valid()){
+    return false;
+  }
+  int year = time.tm_year + 1900;
+  int month = time.tm_mon + 1;
+  return (_minutes >> time.tm_min & 1) && (_hours >> time.tm_hour & 1) && (_months >> month & 1)
+    && (_daysOf(year, month) >> time.tm_mday & 1);
+}
+
+bool Expression::next(const struct tm& after, struct tm& result) const{
+  if (!valid()){
+    return false;
+  }
+
+  int year = after.tm_year + 1900;
+  int month = after.tm_mon + 1;
+  int day = after.tm_mday;
+  int hour = after.tm_hour;
+  int minute = after.tm_min + 1;
+  const int lastYear = year + _searchYears;
+
+  // every step either settles a field or carries into the next larger one,
+  // a field that moves resets the smaller ones
+  while (year <= lastYear){
+    uint32_t months = _from(uint32_t(_months), month);
+    if (!months){
+      year++;
+      month = 1, day = 1, hour = 0, minute = 0;
+      continue;
+    }
+    if (_lowest(months) != month){
+      month = _lowest(months);
+      day = 1, hour = 0, minute = 0;
+    }
+
+    uint32_t days = _from(_daysOf(year, month), day);
+    if (!days){
+      month++;
+      day = 1, hour = 0, minute = 0;
+      continue;
+    }
+    if (_lowest(days) != day){
+      day = _lowest(days);
+      hour = 0, minute = 0;
+    }
+
+    uint32_t hours = _from(_hours, hour);
+    if (!hours){
+      day++;
+      hour = 0, minute = 0;
+      continue;
+    }
+    if (_lowest(hours) != hour){
+      hour = _lowest(hours);
+      minute = 0;
+    }
+
+    uint64_t minutes = _from(_minutes, minute);
+    if (!minutes){
+      hour++;
+      minute = 0;
+      continue;
+    }
+    minute = _lowest(minutes);
+
+    memset(&result, 0, sizeof(result));
+    result.tm_year = year - 1900;
+    result.tm_mon = month - 1;
+    result.tm_mday = day;
+    result.tm_hour = hour;
+    result.tm_min = minute;
+    result.tm_wday = _weekday(year, month, day);
+    result.tm_yday = _dayOfYear(year, month, day);
+    result.tm_isdst = -1;
+    return true;
+  }
+  return false;
+}
+
+time_t Expression::next(time_t after) const{
+  struct tm local, fire;
+  if (!localtime_r(&after, &local) || !next(local, fire)){
+    return time_t(-1);
+  }
+  // a time skipped by daylight saving is moved forward by mktime, a repeated one
+  // may resolve to its first occurrence, before `after`, then take the next match
+  for (int i = 0; i < 4; i++){
+    struct tm normalized = fire;
+    time_t result = mktime(&normalized);
+    if (result == time_t(-1) || result > after){
+      return result;
+    }
+    if (!next(fire, fire)){
+      break;
+    }
+  }
+  return time_t(-1);
+}
+
+END_CRON_NAMESPACE
+END_TASKS_NAMESPACE
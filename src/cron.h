@@ -0,0 +1,112 @@
+#pragma once
+
+/*
+
+Cron expressions, for schedules on the wall clock.
+
+An expression is parsed once into one bitset per field (60 bits of minutes, 24 of
+hours, 31 of days, 12 of months, 7 of weekdays), finding the next firing takes a
+few mask and count-trailing-zeros operations per field, it never steps minute by
+minute.
+
+Standard five fields, separated by spaces:
+
+    minute  hour  day-of-month  month  day-of-week
+    0-59    0-23  1-31          1-12   0-7 (0 and 7 are Sunday)
+
+Every field is a comma separated list of `*`, `value` or `first-last`, each with
+an optional `/step`. Months and weekdays also take their English three letter
+names (`JAN`, `MON`). Like in Vixie cron, when both day-of-month and day-of-week
+are restricted (neither starts with `*`), a day matching either one fires.
+The shortcuts `@yearly`, `@annually`, `@monthly`, `@weekly`, `@daily`, `@midnight`
+and `@hourly` are accepted too.
+
+*/
+
+#include <stdint.h>
+#include <time.h>
+
+#include "namespaces.h"
+
+BEGIN_TASKS_NAMESPACE
+BEGIN_CRON_NAMESPACE
+
+/*
+
+## Expression
+
+A parsed cron expression.
+
+### Example
+
+```cpp
+// at minute 0 and 30 of hours 8 to 18, Monday to Friday
+cron::Expression workHours("0,30 8-18 * * MON-FRI");
+
+time_t next = workHours.next(time(nullptr));
+```
+*/
+class Expression{
+  // bit i is minute i
+  uint64_t _minutes;
+  // bit i is hour i
+  uint32_t _hours;
+  // bit i is day i of the month, bit 0 is unused
+  uint32_t _days;
+  // bit i is month i, bit 0 is unused
+  uint16_t _months;
+  // bit i is weekday i, 0 is Sunday
+  uint8_t _weekdays;
+  // _DaysStar / _WeekdaysStar / _Valid
+  uint8_t _flags;
+
+  static const uint8_t _DaysStar = 1;
+  static const uint8_t _WeekdaysStar = 2;
+  static const uint8_t _Valid = 4;
+
+  bool _parse(const char* text);
+
+  // days of the month `month` of `year` that match both day fields
+  uint32_t _daysOf(int year, int month) const;
+
+public:
+  /**
+   * @brief An invalid expression, that never fires
+  */
+  Expression();
+
+  /**
+   * @brief Parse `text`, check `valid()` for errors
+  */
+  explicit Expression(const char* text);
+
+  /**
+   * @brief Check if the expression was parsed without errors
+  */
+  bool valid() const{
+    return (_flags & _Valid) != 0;
+  }
+
+  /**
+   * @brief Check if the minute of `time` matches the expression
+  */
+  bool matches(const struct tm& time) const;
+
+  /**
+   * @brief Find the first matching minute after `after` (the seconds are ignored),
+   * plain calendar arithmetic, no time zone
+   * @param result The firing time, with seconds set to 0
+   * @return false if the expression is invalid or never matches (like `0 0 30 2 *`)
+  */
+  bool next(const struct tm& after, struct tm& result) const;
+
+  /**
+   * @brief Find the first matching minute after `after`, in local time
+   * (`localtime_r` / `mktime`, so the `TZ` rules and daylight saving apply)
+   * @return The firing time, or -1 if there is none
+  */
+  time_t next(time_t after) const;
+};
+
+END_CRON_NAMESPACE
+END_TASKS_NAMESPACE
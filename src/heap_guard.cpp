@@ -0,0 +1,86 @@
+#include "heap_guard.h"
+
+#include <atomic>
+#include <new>
+#include <stdlib.h>
+
+BEGIN_TASKS_NAMESPACE
+
+namespace {
+
+std::atomic<bool> _locked(false);
+// `_HeapExempt` scopes open on the current thread
+thread_local int _exempt = 0;
+
+}
+
+void lockHeap(){
+    _locked.store(ASYNC_TASKS_HEAP_GUARD != 0, std::memory_order_release);
+}
+
+bool heapLocked(){
+    return _locked.load(std::memory_order_acquire);
+}
+
+_HeapExempt::_HeapExempt(){
+    _exempt++;
+}
+
+_HeapExempt::~_HeapExempt(){
+    _exempt--;
+}
+
+#if ASYNC_TASKS_HEAP_GUARD
+
+// the allocation every replaced `operator new` goes through
+static void* _allocate(size_t size){
+    if (_locked.load(std::memory_order_relaxed) && _exempt == 0){
+        // heap use after `lockHeap()`, the backtrace shows where
+        abort();
+    }
+    return malloc(size ? size : 1);
+}
+
+#endif
+
+END_TASKS_NAMESPACE
+
+#if ASYNC_TASKS_HEAP_GUARD
+
+void* operator new(size_t size){
+    void* ptr = async_tasks::_allocate(size);
+    if (!ptr){
+        abort();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size){
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept{
+    return async_tasks::_allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept{
+    return async_tasks::_allocate(size);
+}
+
+void operator delete(void* ptr) noexcept{
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept{
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept{
+    free(ptr);
+}
+
+#endif
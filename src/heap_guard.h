@@ -0,0 +1,56 @@
+#pragma once
+
+/*
+
+Heap guard of the static mode: after `lockHeap()`, every C++ allocation (the global
+`operator new`, also from the standard containers and `std::string`) aborts, so a heap
+use after startup shows right away, with its backtrace, instead of fragmenting the heap
+weeks later.
+
+The guard replaces the global `operator new` and `operator delete` of the program,
+it's built with `ASYNC_TASKS_HEAP_GUARD`, on by default in static mode (see `port.h`),
+`-DASYNC_TASKS_HEAP_GUARD=0` to keep the toolchain's own. `malloc()` isn't guarded,
+the FreeRTOS kernel and the drivers (WiFi, for example) keep using it. Without the
+guard, `lockHeap()` does nothing.
+
+What still allocates, so it belongs before `lockHeap()`: creating a `Scheduler`,
+`ShardedScheduler`, `TaskPool` or `WorkStealingExecutor`, `run()` of the executors
+(their worker lists), and building a `TaskGraph`. Running tasks, scheduler jobs,
+futures, graphs and channels doesn't allocate.
+
+*/
+
+#include <stddef.h>
+
+#include "port.h"
+#include "namespaces.h"
+
+#ifndef ASYNC_TASKS_HEAP_GUARD
+#   define ASYNC_TASKS_HEAP_GUARD ASYNC_TASKS_STATIC
+#endif
+
+BEGIN_TASKS_NAMESPACE
+
+/**
+ * @brief End of startup: from now on, any `operator new` aborts (with the heap guard,
+ * see `heap_guard.h`), call it at the end of `setup()`
+*/
+void lockHeap();
+
+/**
+ * @brief Check if `lockHeap()` was called and the guard is built
+*/
+bool heapLocked();
+
+/**
+ * Allows allocations on the current thread while it exists, for the host port, where
+ * the simulated kernel allocates with `operator new` what FreeRTOS keeps in its own
+ * static storage, used internally
+*/
+class _HeapExempt{
+  public:
+    _HeapExempt();
+    ~_HeapExempt();
+};
+
+END_TASKS_NAMESPACE
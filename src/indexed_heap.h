@@ -0,0 +1,206 @@
+#pragma once
+
+/*
+
+Indexed binary min-heap.
+
+Stores (key, id) pairs in one contiguous array, and keeps the position of every id,
+so besides O(log n) push and pop, the key of any id can be changed or the id removed
+in O(log n), without searching for it.
+
+*/
+
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "namespaces.h"
+
+BEGIN_TASKS_NAMESPACE
+
+/**
+ * Compares two millisecond timestamps, handles the 32-bit overflow
+ * (every ~49 days), as long as they are less than ~24 days apart
+*/
+struct _ClockBefore{
+    bool operator()(uint32_t a, uint32_t b) const{
+        return int32_t(a - b) < 0;
+    }
+};
+
+template <typename _Key, typename _Less = _ClockBefore>
+class _IndexedHeap{
+    struct _Node{
+        _Key key;
+        uint32_t id;
+    };
+
+    std::vector<_Node> _nodes;
+    // position of every id in `_nodes`, `npos` if it isn't in the heap
+    std::vector<uint32_t> _position;
+    _Less _less;
+
+    void _place(size_t index, const _Node& node){
+        _nodes[index] = node;
+        _position[node.id] = uint32_t(index);
+    }
+
+    void _siftUp(size_t index){
+        _Node node = _nodes[index];
+        while (index > 0){
+            size_t parent = (index - 1) / 2;
+            if (!_less(node.key, _nodes[parent].key)){
+                break;
+            }
+            _place(index, _nodes[parent]);
+            index = parent;
+        }
+        _place(index, node);
+    }
+
+    void _siftDown(size_t index){
+        _Node node = _nodes[index];
+        size_t count = _nodes.size();
+        for (;;){
+            size_t child = 2 * index + 1;
+            if (child >= count){
+                break;
+            }
+            if (child + 1 < count && _less(_nodes[child + 1].key, _nodes[child].key)){
+                child++;
+            }
+            if (!_less(_nodes[child].key, node.key)){
+                break;
+            }
+            _place(index, _nodes[child]);
+            index = child;
+        }
+        _place(index, node);
+    }
+
+public:
+    static const uint32_t npos = 0xffffffff;
+
+    _IndexedHeap(): _nodes(), _position(), _less() {}
+
+    bool empty() const{
+        return _nodes.empty();
+    }
+
+    size_t size() const{
+        return _nodes.size();
+    }
+
+    /**
+     * @brief Reserve memory for `count` ids
+    */
+    void reserve(size_t count){
+        _nodes.reserve(count);
+        _position.reserve(count);
+    }
+
+    /**
+     * @brief Id with the smallest key, heap must not be empty
+    */
+    uint32_t top() const{
+        return _nodes.front().id;
+    }
+
+    /**
+     * @brief The smallest key, heap must not be empty
+    */
+    const _Key& topKey() const{
+        return _nodes.front().key;
+    }
+
+    /**
+     * @brief Node at `index` in the heap array, the root is at 0,
+     * children of `i` are at `2i + 1` and `2i + 2`
+    */
+    uint32_t idAt(size_t index) const{
+        return _nodes[index].id;
+    }
+
+    const _Key& keyAt(size_t index) const{
+        return _nodes[index].key;
+    }
+
+    bool contains(uint32_t id) const{
+        return id < _position.size() && _position[id] != npos;
+    }
+
+    /**
+     * @brief Add `id` with `key`, if it's already in the heap, its key is updated
+    */
+    void push(uint32_t id, const _Key& key){
+        if (contains(id)){
+            update(id, key);
+            return;
+        }
+        if (id >= _position.size()){
+            _position.resize(id + 1, npos);
+        }
+        _nodes.push_back(_Node{key, id});
+        _position[id] = uint32_t(_nodes.size() - 1);
+        _siftUp(_nodes.size() - 1);
+    }
+
+    /**
+     * @brief Change the key of `id`, must be in the heap
+    */
+    void update(uint32_t id, const _Key& key){
+        size_t index = _position[id];
+        bool up = _less(key, _nodes[index].key);
+        _nodes[index].key = key;
+        if (up){
+            _siftUp(index);
+        } else {
+            _siftDown(index);
+        }
+    }
+
+    /**
+     * @brief Remove `id` from the heap, does nothing if it's not there
+    */
+    void remove(uint32_t id){
+        if (!contains(id)){
+            return;
+        }
+        size_t index = _position[id];
+        _position[id] = npos;
+
+        _Node last = _nodes.back();
+        _nodes.pop_back();
+        if (index == _nodes.size()){
+            return;
+        }
+
+        // move the last node into the hole, and restore the order
+        bool up = _less(last.key, _nodes[index].key);
+        _place(index, last);
+        if (up){
+            _siftUp(index);
+        } else {
+            _siftDown(index);
+        }
+    }
+
+    /**
+     * @brief Remove the id with the smallest key, heap must not be empty
+    */
+    uint32_t pop(){
+        uint32_t id = top();
+        remove(id);
+        return id;
+    }
+
+    void clear(){
+        _nodes.clear();
+        _position.clear();
+    }
+};
+
+template <typename _Key, typename _Less>
+const uint32_t _IndexedHeap<_Key, _Less>::npos;
+
+END_TASKS_NAMESPACE
@@ -0,0 +1,242 @@
+#pragma once
+
+/*
+
+Fixed-capacity callable wrapper, a replacement for `std::function` that never allocates.
+
+The callable (function pointer, lambda with its captures, functor) is stored inside
+the object, a callable that doesn't fit fails to compile. The capacity is a template
+parameter, `AsyncTask` uses `ASYNC_TASKS_FUNCTION_CAPACITY` (default 32 bytes), that
+can be changed for the whole build, for example with `-DASYNC_TASKS_FUNCTION_CAPACITY=64`.
+
+The function can be copied, so a move-only callable (a functor holding a `std::unique_ptr`
+for example) fails to compile, `AsyncTask` copies its function. With `_Copyable` false
+(`UniqueFunction`) move-only callables are stored too, and copying the function itself
+fails to compile instead. The callable type is erased, so this can't depend on it.
+
+*/
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "namespaces.h"
+
+#ifndef ASYNC_TASKS_FUNCTION_CAPACITY
+#   define ASYNC_TASKS_FUNCTION_CAPACITY 32
+#endif
+
+BEGIN_TASKS_NAMESPACE
+
+template <typename _Signature, size_t _Capacity = ASYNC_TASKS_FUNCTION_CAPACITY, bool _Copyable = true>
+class InplaceFunction;
+
+/**
+ * `InplaceFunction` that only moves, so it can store move-only callables
+*/
+template <typename _Signature, size_t _Capacity = ASYNC_TASKS_FUNCTION_CAPACITY>
+using UniqueFunction = InplaceFunction<_Signature, _Capacity, false>;
+
+template <typename _Res, typename... _ArgTypes, size_t _Capacity, bool _Copyable>
+class InplaceFunction<_Res(_ArgTypes...), _Capacity, _Copyable>{
+
+    // parameter of the copy constructor and assignment of a move-only function, so they
+    // are not declared, and the implicit ones are deleted (there is a move constructor)
+    struct _NoCopy{};
+    typedef typename std::conditional<_Copyable, const InplaceFunction&, const _NoCopy&>::type _CopySource;
+
+    static const size_t _Align = alignof(std::max_align_t);
+
+    // Type-erased operations on the stored callable, one static table per callable type
+    struct _VTable{
+        _Res (*invoke)(void* storage, _ArgTypes&&... args);
+        // nullptr if the callable is move-only
+        void (*copy)(void* dst, const void* src);
+        // move-construct into `dst`, and destroy `src`
+        void (*move)(void* dst, void* src);
+        void (*destroy)(void* storage);
+    };
+
+    template <typename _Fn>
+    struct _Ops{
+        static _Res invoke(void* storage, _ArgTypes&&... args){
+            return (*static_cast<_Fn*>(storage))(std::forward<_ArgTypes>(args)...);
+        }
+
+        static void copy(void* dst, const void* src){
+            new (dst) _Fn(*static_cast<const _Fn*>(src));
+        }
+
+        static void move(void* dst, void* src){
+            new (dst) _Fn(std::move(*static_cast<_Fn*>(src)));
+            static_cast<_Fn*>(src)->~_Fn();
+        }
+
+        static void destroy(void* storage){
+            static_cast<_Fn*>(storage)->~_Fn();
+        }
+
+        template <typename _Tp = _Fn>
+        static constexpr typename std::enable_if<std::is_copy_constructible<_Tp>::value, void (*)(void*, const void*)>::type
+        copier(){
+            return &copy;
+        }
+
+        template <typename _Tp = _Fn>
+        static constexpr typename std::enable_if<!std::is_copy_constructible<_Tp>::value, void (*)(void*, const void*)>::type
+        copier(){
+            return nullptr;
+        }
+
+        static const _VTable table;
+    };
+
+    // True if `_Fn` can be called with `_ArgTypes...` and the result converts to `_Res`
+    template <typename _Fn, typename = void>
+    struct _Callable : std::false_type {};
+
+    template <typename _Fn>
+    struct _Callable<_Fn, typename std::enable_if<
+        std::is_void<_Res>::value ||
+        std::is_convertible<decltype(std::declval<_Fn&>()(std::declval<_ArgTypes>()...)), _Res>::value,
+        decltype(void(std::declval<_Fn&>()(std::declval<_ArgTypes>()...)))
+    >::type> : std::true_type {};
+
+    typename std::aligned_storage<_Capacity, _Align>::type _storage;
+    const _VTable* _vtable;
+
+    void _reset(){
+        if (_vtable){
+            _vtable->destroy(&_storage);
+            _vtable = nullptr;
+        }
+    }
+
+    void _copyFrom(const InplaceFunction& other){
+        if (other._vtable){
+            other._vtable->copy(&_storage, &other._storage);
+            _vtable = other._vtable;
+        }
+    }
+
+    void _moveFrom(InplaceFunction& other){
+        if (other._vtable){
+            other._vtable->move(&_storage, &other._storage);
+            _vtable = other._vtable;
+            other._vtable = nullptr;
+        }
+    }
+
+public:
+    InplaceFunction(): _vtable(nullptr) {}
+    InplaceFunction(std::nullptr_t): _vtable(nullptr) {}
+
+    template <
+        typename _Fn,
+        typename _Decayed = typename std::decay<_Fn>::type,
+        typename = typename std::enable_if<
+            !std::is_same<_Decayed, InplaceFunction>::value && _Callable<_Decayed>::value
+        >::type
+    >
+    InplaceFunction(_Fn&& fn): _vtable(nullptr){
+        static_assert(sizeof(_Decayed) <= _Capacity,
+            "Callable doesn't fit into InplaceFunction, capture less or increase the capacity (ASYNC_TASKS_FUNCTION_CAPACITY)");
+        static_assert(alignof(_Decayed) <= _Align,
+            "Callable is over-aligned for InplaceFunction");
+        static_assert(!_Copyable || std::is_copy_constructible<_Decayed>::value,
+            "Callable can't be copied, and this InplaceFunction (or AsyncTask) copies it, capture a copyable handle (a shared pointer) or store it in a UniqueFunction");
+
+        // an empty function pointer makes an empty function, like with std::function
+        if (_isNull(fn)){
+            return;
+        }
+        new (&_storage) _Decayed(std::forward<_Fn>(fn));
+        _vtable = &_Ops<_Decayed>::table;
+    }
+
+    InplaceFunction(_CopySource other): _vtable(nullptr){
+        _copyFrom(other);
+    }
+
+    InplaceFunction(InplaceFunction&& other): _vtable(nullptr){
+        _moveFrom(other);
+    }
+
+    ~InplaceFunction(){
+        _reset();
+    }
+
+    InplaceFunction& operator=(_CopySource other){
+        if (this != &other){
+            _reset();
+            _copyFrom(other);
+        }
+        return *this;
+    }
+
+    InplaceFunction& operator=(InplaceFunction&& other){
+        if (this != &other){
+            _reset();
+            _moveFrom(other);
+        }
+        return *this;
+    }
+
+    InplaceFunction& operator=(std::nullptr_t){
+        _reset();
+        return *this;
+    }
+
+    template <
+        typename _Fn,
+        typename = typename std::enable_if<
+            !std::is_same<typename std::decay<_Fn>::type, InplaceFunction>::value
+        >::type
+    >
+    InplaceFunction& operator=(_Fn&& fn){
+        return *this = InplaceFunction(std::forward<_Fn>(fn));
+    }
+
+    /**
+     * @brief Call the stored callable, must not be empty
+    */
+    _Res operator()(_ArgTypes... args) const{
+        return _vtable->invoke(const_cast<void*>(static_cast<const void*>(&_storage)), std::forward<_ArgTypes>(args)...);
+    }
+
+    /**
+     * @brief Call the stored callable with the arguments forwarded as they are, without
+     * the by-value copy made by `operator()`, must not be empty, used internally
+    */
+    _Res _invoke(_ArgTypes&&... args) const{
+        return _vtable->invoke(const_cast<void*>(static_cast<const void*>(&_storage)), std::forward<_ArgTypes>(args)...);
+    }
+
+    explicit operator bool() const{
+        return _vtable != nullptr;
+    }
+
+private:
+    template <typename _Fn>
+    static bool _isNull(const _Fn&){
+        return false;
+    }
+
+    template <typename _FnRes, typename... _FnArgs>
+    static bool _isNull(_FnRes (* const& fn)(_FnArgs...)){
+        return fn == nullptr;
+    }
+};
+
+template <typename _Res, typename... _ArgTypes, size_t _Capacity, bool _Copyable>
+template <typename _Fn>
+const typename InplaceFunction<_Res(_ArgTypes...), _Capacity, _Copyable>::_VTable
+InplaceFunction<_Res(_ArgTypes...), _Capacity, _Copyable>::_Ops<_Fn>::table = {
+    &_Ops<_Fn>::invoke,
+    _Ops<_Fn>::copier(),
+    &_Ops<_Fn>::move,
+    &_Ops<_Fn>::destroy,
+};
+
+END_TASKS_NAMESPACE
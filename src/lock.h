@@ -1,6 +1,6 @@
 #pragma once
 
-#include <Arduino.h>
+#include "port.h"
 
 #include "namespaces.h"
 
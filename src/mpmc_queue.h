@@ -0,0 +1,123 @@
+#pragma once
+
+/*
+
+Bounded lock-free multi-producer / multi-consumer queue.
+
+Every cell has a sequence number that tells producers and consumers whose turn
+it is, so `push` and `pop` are a single compare-and-swap on the happy path, never
+block and never allocate after construction.
+
+*/
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "namespaces.h"
+
+BEGIN_TASKS_NAMESPACE
+
+template <typename _Tp>
+class _MpmcQueue{
+    struct _Cell{
+        std::atomic<uint32_t> sequence;
+        _Tp data;
+    };
+
+    std::unique_ptr<_Cell[]> _cells;
+    uint32_t _mask;
+    std::atomic<uint32_t> _head;
+    std::atomic<uint32_t> _tail;
+
+public:
+    /**
+     * @brief Create the queue, capacity is rounded up to a power of 2
+    */
+    explicit _MpmcQueue(size_t capacity): _cells(), _mask(0), _head(0), _tail(0){
+        uint32_t size = 2;
+        while (size < capacity){
+            size <<= 1;
+        }
+        _cells.reset(new _Cell[size]);
+        _mask = size - 1;
+        for (uint32_t i = 0; i < size; i++){
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    _MpmcQueue(const _MpmcQueue&) = delete;
+    _MpmcQueue& operator=(const _MpmcQueue&) = delete;
+
+    /**
+     * @brief Add an item, doesn't block
+     * @return false if the queue is full
+    */
+    bool push(const _Tp& item){
+        uint32_t pos = _tail.load(std::memory_order_relaxed);
+        for (;;){
+            _Cell& cell = _cells[pos & _mask];
+            uint32_t seq = cell.sequence.load(std::memory_order_acquire);
+            int32_t diff = int32_t(seq - pos);
+            if (diff == 0){
+                if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                    cell.data = item;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0){
+                return false;
+            } else {
+                pos = _tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Remove the oldest item, doesn't block
+     * @return false if the queue is empty
+    */
+    bool pop(_Tp& item){
+        uint32_t pos = _head.load(std::memory_order_relaxed);
+        for (;;){
+            _Cell& cell = _cells[pos & _mask];
+            uint32_t seq = cell.sequence.load(std::memory_order_acquire);
+            int32_t diff = int32_t(seq - (pos + 1));
+            if (diff == 0){
+                if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                    item = cell.data;
+                    cell.sequence.store(pos + _mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0){
+                return false;
+            } else {
+                pos = _head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * @brief Check if the queue looks empty, might be outdated right after the call
+    */
+    bool empty() const{
+        return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Check if `pop()` would find an item. Unlike `empty()`, an item behind a
+     * slot a producer reserved but didn't fill yet doesn't count, it can't be popped
+     * until that producer is done. Might be outdated right after the call
+    */
+    bool ready() const{
+        uint32_t pos = _head.load(std::memory_order_acquire);
+        return _cells[pos & _mask].sequence.load(std::memory_order_acquire) == pos + 1;
+    }
+
+    size_t capacity() const{
+        return size_t(_mask) + 1;
+    }
+};
+
+END_TASKS_NAMESPACE
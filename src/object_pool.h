@@ -0,0 +1,201 @@
+#pragma once
+
+/*
+
+Fixed-capacity object pool.
+
+Slots live inside the pool object (usually a static), free slots are kept in a
+lock-free stack, so allocating and freeing is O(1), never blocks, and doesn't touch
+the general heap. Only when all slots are in use, the pool falls back to the heap,
+which is counted in the statistics, use them to pick the right capacity. In static
+mode (`ASYNC_TASKS_STATIC`, see `port.h`) it returns nullptr instead.
+
+Every pool reserves its slots up front, in `.bss`: `capacity * sizeof(_Tp)` bytes
+from the first use of its type, whether the slots are used or not. Every `AsyncTask`
+type has its own pool of copies (see `AsyncTask::_pool()`), so a task with a large
+argument costs that much RAM per type, 16 slots of a 4 KB argument are 64 KB.
+
+The default capacity of the library's pools can be changed for the whole build,
+for example with `-DASYNC_TASKS_POOL_CAPACITY=32`, and for one type by specializing
+`PoolCapacity`.
+
+*/
+
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "port.h"
+#include "namespaces.h"
+
+#ifndef ASYNC_TASKS_POOL_CAPACITY
+#   define ASYNC_TASKS_POOL_CAPACITY 16
+#endif
+
+BEGIN_TASKS_NAMESPACE
+
+/**
+ * Usage statistics of an `ObjectPool`
+*/
+struct PoolStats{
+    // number of slots in the pool
+    size_t capacity;
+    // objects currently allocated (from the slots and the heap)
+    size_t used;
+    // the most objects that were ever allocated at the same time
+    size_t highWater;
+    // number of allocations that didn't fit into the pool and went to the heap
+    // (failed, in static mode)
+    size_t overflows;
+};
+
+/**
+ * Number of slots of the pool of `_Tp`, `ASYNC_TASKS_POOL_CAPACITY` unless specialized.
+ * Specialize it before the type is first used (before the first `run()` of an `AsyncTask`
+ * type), in every file using it, for example in a header included after the library:
+ *
+ *     namespace async_tasks{
+ *     template <> struct PoolCapacity<AsyncTask<Frame>>{
+ *         static constexpr size_t value = 2;
+ *     };
+ *     }
+*/
+template <typename _Tp>
+struct PoolCapacity{
+    static constexpr size_t value = ASYNC_TASKS_POOL_CAPACITY;
+};
+
+template <typename _Tp>
+constexpr size_t PoolCapacity<_Tp>::value;
+
+template <typename _Tp, size_t _Capacity = PoolCapacity<_Tp>::value>
+class ObjectPool{
+    static_assert(_Capacity > 0 && _Capacity < 0xffff, "ObjectPool capacity must be between 1 and 65534");
+
+    static const uint32_t _empty = 0xffff;
+
+    typename std::aligned_storage<sizeof(_Tp), alignof(_Tp)>::type _slots[_Capacity];
+    // next free slot of every free slot
+    std::atomic<uint16_t> _next[_Capacity];
+    // top of the free stack, low 16 bits are the slot index, high 16 bits a counter
+    // incremented on every change, so a slot freed and taken again between our read
+    // and our compare-and-swap doesn't corrupt the stack (ABA problem)
+    std::atomic<uint32_t> _head;
+
+    std::atomic<uint32_t> _used;
+    std::atomic<uint32_t> _highWater;
+    std::atomic<uint32_t> _overflows;
+
+    bool _owns(const void* ptr) const{
+        const char* p = static_cast<const char*>(ptr);
+        const char* begin = reinterpret_cast<const char*>(&_slots[0]);
+        const char* end = reinterpret_cast<const char*>(&_slots[_Capacity]);
+        return p >= begin && p < end;
+    }
+
+    void _recordUse(){
+        uint32_t used = _used.fetch_add(1, std::memory_order_relaxed) + 1;
+        uint32_t high = _highWater.load(std::memory_order_relaxed);
+        while (used > high && !_highWater.compare_exchange_weak(high, used, std::memory_order_relaxed)) {}
+    }
+
+public:
+    ObjectPool(): _head(0), _used(0), _highWater(0), _overflows(0){
+        for (size_t i = 0; i < _Capacity; i++){
+            _next[i].store(uint16_t(i + 1 < _Capacity ? i + 1 : _empty), std::memory_order_relaxed);
+        }
+    }
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    /**
+     * @brief Get memory for one object, from a free slot or from the heap if there is none,
+     * nullptr in static mode
+    */
+    void* allocate(){
+        uint32_t head = _head.load(std::memory_order_acquire);
+        for (;;){
+            uint32_t index = head & 0xffff;
+            if (index == _empty){
+                _overflows.fetch_add(1, std::memory_order_relaxed);
+#if ASYNC_TASKS_STATIC
+                return nullptr;
+#else
+                _recordUse();
+                return ::operator new(sizeof(_Tp));
+#endif
+            }
+            uint32_t next = _next[index].load(std::memory_order_relaxed);
+            uint32_t tagged = ((head + 0x10000) & 0xffff0000) | next;
+            if (_head.compare_exchange_weak(head, tagged, std::memory_order_acquire, std::memory_order_acquire)){
+                _recordUse();
+                return &_slots[index];
+            }
+        }
+    }
+
+    /**
+     * @brief Give back memory returned by `allocate()`
+    */
+    void deallocate(void* ptr){
+        if (!ptr){
+            return;
+        }
+        _used.fetch_sub(1, std::memory_order_relaxed);
+#if !ASYNC_TASKS_STATIC
+        if (!_owns(ptr)){
+            ::operator delete(ptr);
+            return;
+        }
+#endif
+
+        uint32_t index = uint32_t(reinterpret_cast<typename std::aligned_storage<sizeof(_Tp), alignof(_Tp)>::type*>(ptr) - &_slots[0]);
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        for (;;){
+            _next[index].store(uint16_t(head & 0xffff), std::memory_order_relaxed);
+            uint32_t tagged = ((head + 0x10000) & 0xffff0000) | index;
+            if (_head.compare_exchange_weak(head, tagged, std::memory_order_release, std::memory_order_relaxed)){
+                return;
+            }
+        }
+    }
+
+    /**
+     * @brief Allocate and construct an object, nullptr if there is no memory left,
+     * the arguments are left untouched then
+    */
+    template <typename... _ArgTypes>
+    _Tp* create(_ArgTypes&&... args){
+        void* memory = allocate();
+        return memory ? new (memory) _Tp(std::forward<_ArgTypes>(args)...) : nullptr;
+    }
+
+    /**
+     * @brief Destroy and free an object returned by `create()`
+    */
+    void destroy(_Tp* ptr){
+        if (!ptr){
+            return;
+        }
+        ptr->~_Tp();
+        deallocate(ptr);
+    }
+
+    PoolStats stats() const{
+        PoolStats stats;
+        stats.capacity = _Capacity;
+        stats.used = _used.load(std::memory_order_relaxed);
+        stats.highWater = _highWater.load(std::memory_order_relaxed);
+        stats.overflows = _overflows.load(std::memory_order_relaxed);
+        return stats;
+    }
+};
+
+template <typename _Tp, size_t _Capacity>
+const uint32_t ObjectPool<_Tp, _Capacity>::_empty;
+
+END_TASKS_NAMESPACE
@@ -0,0 +1,34 @@
+#pragma once
+
+/*
+
+Platform layer of the library.
+
+On the boards, the FreeRTOS and Arduino API comes from the core (`Arduino.h`).
+When built with `ASYNC_TASKS_HOST` defined (see `CMakeLists.txt`), the same API
+is provided by the Linux / pthreads backend in `port/host`, used for benchmarks
+and testing off-device.
+
+*/
+
+#if defined(ASYNC_TASKS_HOST)
+#   include "port/host/freertos_host.h"
+#else
+#   include <Arduino.h>
+#endif
+
+/*
+
+Static mode: no heap use after startup. Enabled with `-DASYNC_TASKS_STATIC=1`,
+or by the FreeRTOS config when it has no dynamic allocation, tasks are then
+created only from a `StackPool` (or run on an executor), and the object pools
+fail instead of falling back to the heap when they're full.
+
+*/
+#ifndef ASYNC_TASKS_STATIC
+#   if defined(configSUPPORT_DYNAMIC_ALLOCATION) && configSUPPORT_DYNAMIC_ALLOCATION == 0
+#       define ASYNC_TASKS_STATIC 1
+#   else
+#       define ASYNC_TASKS_STATIC 0
+#   endif
+#endif
@@ -0,0 +1,615 @@
+#if defined(ASYNC_TASKS_HOST)
+
+#include "freertos_host.h"
+#include "../../heap_guard.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+
+All kernel objects are guarded by a single kernel mutex, the same way the
+FreeRTOS kernel serializes its lists inside critical sections. Every task owns
+a condition variable used for notifications, delays and suspension; semaphores
+and queues have their own condition variables for their waiters.
+
+*/
+
+namespace {
+
+// Minimal stack given to a host thread, C library calls need much more than
+// the few kilobytes an embedded task is usually given
+const size_t _minHostStack = 64 * 1024;
+
+// Pattern used to find the stack high water mark
+const uint8_t _stackFill = 0xa5;
+
+std::mutex& _kernel(){
+    static std::mutex kernel;
+    return kernel;
+}
+
+typedef std::unique_lock<std::mutex> _KernelLock;
+typedef std::chrono::steady_clock _Clock;
+
+_Clock::time_point _epoch(){
+    static const _Clock::time_point epoch = _Clock::now();
+    return epoch;
+}
+
+// Make sure the epoch is captured at startup, not on the first call
+const _Clock::time_point _startup = _epoch();
+
+} // namespace
+
+struct _HostTask{
+    pthread_t thread;
+    std::string name;
+    TaskFunction_t fn;
+    void* param;
+    UBaseType_t priority;
+    BaseType_t core;
+    uint8_t* stack;
+    size_t stackSize;
+    uint32_t requestedStack;
+    bool ownsStack;
+    bool foreign;
+
+    // Guarded by the kernel mutex
+    bool started;
+    bool suspended;
+    bool deleted;
+    // waiting in `_checkpoint()` until resumed
+    bool parked;
+    // joined by the task that deleted it, instead of the zombie list
+    bool joined;
+    uint32_t notifyValue;
+    std::condition_variable cv;
+    std::condition_variable* waitingOn;
+
+    _HostTask():
+        thread(), name(), fn(nullptr), param(nullptr), priority(0),
+        core(tskNO_AFFINITY), stack(nullptr), stackSize(0), requestedStack(0),
+        ownsStack(false), foreign(false), started(false), suspended(false), deleted(false),
+        parked(false), joined(false), notifyValue(0), cv(), waitingOn(nullptr) {}
+};
+
+struct _HostSemaphore{
+    enum Type { Mutex, Binary, Counting } type;
+    UBaseType_t count;
+    UBaseType_t maxCount;
+    std::condition_variable cv;
+
+    _HostSemaphore(Type type, UBaseType_t maxCount, UBaseType_t count):
+        type(type), count(count), maxCount(maxCount), cv() {}
+};
+
+struct _HostQueue{
+    std::vector<uint8_t> buffer;
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    UBaseType_t head;
+    UBaseType_t count;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+
+    _HostQueue(UBaseType_t length, UBaseType_t itemSize):
+        buffer(size_t(length) * itemSize), length(length), itemSize(itemSize),
+        head(0), count(0), notEmpty(), notFull() {}
+};
+
+namespace {
+
+thread_local _HostTask* _current = nullptr;
+
+// Tasks that exited and are waiting to be joined, like the FreeRTOS idle task cleanup
+std::vector<_HostTask*>& _zombies(){
+    static std::vector<_HostTask*> zombies;
+    return zombies;
+}
+
+// Join and free tasks that already exited, must be called without the kernel lock
+void _reapZombies(){
+    std::vector<_HostTask*> zombies;
+    {
+        _KernelLock lock(_kernel());
+        zombies.swap(_zombies());
+    }
+    for (auto task : zombies){
+        pthread_join(task->thread, nullptr);
+        if (task->ownsStack){
+            free(task->stack);
+        }
+        delete task;
+    }
+}
+
+// Current task, threads not created through this layer get a handle on first use
+_HostTask* _self(){
+    if (!_current){
+        async_tasks::_HeapExempt exempt;
+        _current = new _HostTask();
+        _current->foreign = true;
+        _current->thread = pthread_self();
+        _current->name = "main";
+    }
+    return _current;
+}
+
+[[noreturn]] void _exitTask(_KernelLock& lock, _HostTask* self){
+    if (!self->foreign && !self->joined){
+        async_tasks::_HeapExempt exempt;
+        _zombies().push_back(self);
+    }
+    lock.unlock();
+    pthread_exit(nullptr);
+}
+
+// Honour pending suspend and delete requests, called with the kernel lock held
+void _checkpoint(_KernelLock& lock, _HostTask* self){
+    while (self->suspended && !self->deleted){
+        self->waitingOn = &self->cv;
+        self->parked = true;
+        self->cv.wait(lock);
+        self->parked = false;
+        self->waitingOn = nullptr;
+    }
+    if (self->deleted){
+        _exitTask(lock, self);
+    }
+}
+
+// Block on `cv` until `ready()` or until `ticks` elapse, returns `ready()`
+template <typename _Pred>
+bool _block(_KernelLock& lock, std::condition_variable& cv, TickType_t ticks, _Pred ready){
+    _HostTask* self = _self();
+    const bool forever = ticks == portMAX_DELAY;
+    // timeouts end on a tick, like with the tick interrupt of FreeRTOS, not `ticks` from
+    // the middle of the current one, or a wait for the next tick would often sleep past it
+    const _Clock::time_point tick = _epoch() + std::chrono::duration_cast<std::chrono::milliseconds>(_Clock::now() - _epoch());
+    const _Clock::time_point deadline = tick + std::chrono::milliseconds(ticks);
+
+    for (;;){
+        _checkpoint(lock, self);
+        if (ready()){
+            return true;
+        }
+        if (ticks == 0){
+            return false;
+        }
+        self->waitingOn = &cv;
+        bool timedOut = false;
+        if (forever){
+            cv.wait(lock);
+        } else {
+            timedOut = cv.wait_until(lock, deadline) == std::cv_status::timeout;
+        }
+        self->waitingOn = nullptr;
+        if (timedOut){
+            _checkpoint(lock, self);
+            return ready();
+        }
+    }
+}
+
+void* _threadEntry(void* param){
+    _HostTask* task = static_cast<_HostTask*>(param);
+    _current = task;
+
+    if (task->core != tskNO_AFFINITY){
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(int(task->core % std::max(1L, cpus)), &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    {
+        // Wait until the creator stored the handle, like FreeRTOS does before the task is ready
+        _KernelLock lock(_kernel());
+        while (!task->started){
+            task->cv.wait(lock);
+        }
+        _checkpoint(lock, task);
+    }
+
+    task->fn(task->param);
+
+    // FreeRTOS tasks must not return, treat it as a self-delete
+    vTaskDelete(nullptr);
+    return nullptr;
+}
+
+_HostTask* _createTask(
+    TaskFunction_t fn, const char* name, uint32_t stackDepth, void* param,
+    UBaseType_t priority, BaseType_t core, uint8_t* stack
+){
+    _reapZombies();
+
+    // the task and its thread live on the heap here, FreeRTOS doesn't need it
+    async_tasks::_HeapExempt exempt;
+    _HostTask* task = new _HostTask();
+    task->fn = fn;
+    task->param = param;
+    task->name = name ? name : "";
+    task->priority = priority;
+    task->core = core;
+    task->requestedStack = stackDepth;
+
+    size_t size = std::max<size_t>(stackDepth, _minHostStack);
+    if (stack && stackDepth >= _minHostStack){
+        task->stack = stack;
+        task->ownsStack = false;
+    } else {
+        task->stack = static_cast<uint8_t*>(aligned_alloc(64, (size + 63) & ~size_t(63)));
+        task->ownsStack = true;
+    }
+    task->stackSize = size;
+    memset(task->stack, _stackFill, size);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, task->stack, size);
+    int err = pthread_create(&task->thread, &attr, _threadEntry, task);
+    pthread_attr_destroy(&attr);
+
+    if (err != 0){
+        if (task->ownsStack){
+            free(task->stack);
+        }
+        delete task;
+        return nullptr;
+    }
+    return task;
+}
+
+// Let a created task run, after its handle was handed out
+void _startTask(_HostTask* task){
+    if (!task){
+        return;
+    }
+    _KernelLock lock(_kernel());
+    task->started = true;
+    task->cv.notify_all();
+}
+
+} // namespace
+
+// ---- Tasks ----
+
+BaseType_t xTaskCreatePinnedToCore(
+    TaskFunction_t fn, const char* name, uint32_t stackDepth,
+    void* param, UBaseType_t priority, TaskHandle_t* created, BaseType_t core
+){
+    _HostTask* task = _createTask(fn, name, stackDepth, param, priority, core, nullptr);
+    if (created){
+        *created = task;
+    }
+    _startTask(task);
+    return task ? pdPASS : pdFAIL;
+}
+
+BaseType_t xTaskCreate(
+    TaskFunction_t fn, const char* name, uint32_t stackDepth,
+    void* param, UBaseType_t priority, TaskHandle_t* created
+){
+    return xTaskCreatePinnedToCore(fn, name, stackDepth, param, priority, created, tskNO_AFFINITY);
+}
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(
+    TaskFunction_t fn, const char* name, uint32_t stackDepth,
+    void* param, UBaseType_t priority, StackType_t* stack,
+    StaticTask_t* tcb, BaseType_t core
+){
+    (void)tcb;
+    _HostTask* task = _createTask(fn, name, stackDepth, param, priority, core, stack);
+    _startTask(task);
+    return task;
+}
+
+TaskHandle_t xTaskCreateStatic(
+    TaskFunction_t fn, const char* name, uint32_t stackDepth,
+    void* param, UBaseType_t priority, StackType_t* stack, StaticTask_t* tcb
+){
+    return xTaskCreateStaticPinnedToCore(fn, name, stackDepth, param, priority, stack, tcb, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task){
+    _KernelLock lock(_kernel());
+    _HostTask* self = _self();
+    if (!task || task == self){
+        self->deleted = true;
+        _exitTask(lock, self);
+    }
+    task->deleted = true;
+    task->cv.notify_all();
+    if (task->waitingOn){
+        task->waitingOn->notify_all();
+    }
+    // a suspended task is gone when this returns, like on FreeRTOS, so its static
+    // stack can be given to a new task right away
+    if (task->parked && !task->foreign){
+        task->joined = true;
+        lock.unlock();
+        pthread_join(task->thread, nullptr);
+        if (task->ownsStack){
+            free(task->stack);
+        }
+        delete task;
+    }
+}
+
+void vTaskSuspend(TaskHandle_t task){
+    _KernelLock lock(_kernel());
+    _HostTask* self = _self();
+    if (!task || task == self){
+        self->suspended = true;
+        _checkpoint(lock, self);
+        return;
+    }
+    task->suspended = true;
+}
+
+eTaskState eTaskGetState(TaskHandle_t task){
+    _KernelLock lock(_kernel());
+    if (!task || task == _self()){
+        return eRunning;
+    }
+    if (task->deleted){
+        return eDeleted;
+    }
+    if (task->parked){
+        return eSuspended;
+    }
+    return task->waitingOn ? eBlocked : eReady;
+}
+
+void vTaskResume(TaskHandle_t task){
+    if (!task){
+        return;
+    }
+    _KernelLock lock(_kernel());
+    task->suspended = false;
+    task->cv.notify_all();
+    // Wake it from whatever it's blocked on, so it re-evaluates its wait
+    if (task->waitingOn){
+        task->waitingOn->notify_all();
+    }
+}
+
+void vTaskDelay(TickType_t ticks){
+    _KernelLock lock(_kernel());
+    _HostTask* self = _self();
+    _block(lock, self->cv, ticks, [](){ return false; });
+}
+
+BaseType_t xTaskDelayUntil(TickType_t* previousWake, TickType_t increment){
+    TickType_t wake = *previousWake + increment;
+    *previousWake = wake;
+    TickType_t now = xTaskGetTickCount();
+    // Deadline already passed, don't block
+    if (TickType_t(wake - now) > increment){
+        return pdFALSE;
+    }
+    vTaskDelay(wake - now);
+    return pdTRUE;
+}
+
+void vTaskDelayUntil(TickType_t* previousWake, TickType_t increment){
+    xTaskDelayUntil(previousWake, increment);
+}
+
+TickType_t xTaskGetTickCount(){
+    return TickType_t(configINITIAL_TICK_COUNT + millis());
+}
+
+TickType_t xTaskGetTickCountFromISR(){
+    return xTaskGetTickCount();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(){
+    return _self();
+}
+
+const char* pcTaskGetName(TaskHandle_t task){
+    return (task ? task : _self())->name.c_str();
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task){
+    _HostTask* t = task ? task : _self();
+    if (!t->stack){
+        return 0;
+    }
+    // The stack grows down, count untouched bytes from the bottom
+    size_t untouched = 0;
+    while (untouched < t->stackSize && t->stack[untouched] == _stackFill){
+        untouched++;
+    }
+    size_t used = t->stackSize - untouched;
+    return used >= t->requestedStack ? 0 : UBaseType_t(t->requestedStack - used);
+}
+
+void vTaskPrioritySet(TaskHandle_t task, UBaseType_t priority){
+    _KernelLock lock(_kernel());
+    (task ? task : _self())->priority = priority;
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task){
+    _KernelLock lock(_kernel());
+    return (task ? task : _self())->priority;
+}
+
+BaseType_t xPortGetCoreID(){
+    _HostTask* self = _self();
+    if (self->core != tskNO_AFFINITY){
+        return self->core % portNUM_PROCESSORS;
+    }
+    int cpu = sched_getcpu();
+    return cpu < 0 ? 0 : cpu % portNUM_PROCESSORS;
+}
+
+void taskYIELD(){
+    sched_yield();
+}
+
+// ---- Direct to task notifications ----
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task){
+    _KernelLock lock(_kernel());
+    task->notifyValue++;
+    task->cv.notify_all();
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken){
+    xTaskNotifyGive(task);
+    if (higherPriorityTaskWoken){
+        *higherPriorityTaskWoken = pdTRUE;
+    }
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait){
+    _KernelLock lock(_kernel());
+    _HostTask* self = _self();
+    _block(lock, self->cv, ticksToWait, [self](){ return self->notifyValue != 0; });
+    uint32_t value = self->notifyValue;
+    if (value){
+        self->notifyValue = clearOnExit ? 0 : value - 1;
+    }
+    return value;
+}
+
+// ---- Semaphores ----
+
+SemaphoreHandle_t xSemaphoreCreateMutex(){
+    async_tasks::_HeapExempt exempt;
+    return new _HostSemaphore(_HostSemaphore::Mutex, 1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(){
+    async_tasks::_HeapExempt exempt;
+    return new _HostSemaphore(_HostSemaphore::Binary, 1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount){
+    async_tasks::_HeapExempt exempt;
+    return new _HostSemaphore(_HostSemaphore::Counting, maxCount, initialCount);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait){
+    _KernelLock lock(_kernel());
+    if (!_block(lock, semaphore->cv, ticksToWait, [semaphore](){ return semaphore->count > 0; })){
+        return pdFALSE;
+    }
+    semaphore->count--;
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore){
+    _KernelLock lock(_kernel());
+    if (semaphore->count >= semaphore->maxCount){
+        return pdFALSE;
+    }
+    semaphore->count++;
+    semaphore->cv.notify_one();
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t* higherPriorityTaskWoken){
+    BaseType_t given = xSemaphoreGive(semaphore);
+    if (given && higherPriorityTaskWoken){
+        *higherPriorityTaskWoken = pdTRUE;
+    }
+    return given;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore){
+    delete semaphore;
+}
+
+// ---- Queues ----
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize){
+    async_tasks::_HeapExempt exempt;
+    return new _HostQueue(length, itemSize);
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticksToWait){
+    _KernelLock lock(_kernel());
+    if (!_block(lock, queue->notFull, ticksToWait, [queue](){ return queue->count < queue->length; })){
+        return errQUEUE_FULL;
+    }
+    UBaseType_t tail = (queue->head + queue->count) % queue->length;
+    memcpy(&queue->buffer[size_t(tail) * queue->itemSize], item, queue->itemSize);
+    queue->count++;
+    queue->notEmpty.notify_one();
+    return pdPASS;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void* item, BaseType_t* higherPriorityTaskWoken){
+    BaseType_t sent = xQueueSend(queue, item, 0);
+    if (sent && higherPriorityTaskWoken){
+        *higherPriorityTaskWoken = pdTRUE;
+    }
+    return sent;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticksToWait){
+    _KernelLock lock(_kernel());
+    if (!_block(lock, queue->notEmpty, ticksToWait, [queue](){ return queue->count > 0; })){
+        return errQUEUE_EMPTY;
+    }
+    memcpy(item, &queue->buffer[size_t(queue->head) * queue->itemSize], queue->itemSize);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    queue->notFull.notify_one();
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue){
+    _KernelLock lock(_kernel());
+    return queue->count;
+}
+
+void vQueueDelete(QueueHandle_t queue){
+    delete queue;
+}
+
+// ---- Arduino core ----
+
+unsigned long millis(){
+    return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(
+        _Clock::now() - _epoch()
+    ).count();
+}
+
+unsigned long micros(){
+    return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+        _Clock::now() - _epoch()
+    ).count();
+}
+
+void delay(unsigned long ms){
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+void delayMicroseconds(unsigned int us){
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void yield(){
+    taskYIELD();
+}
+
+#endif
@@ -0,0 +1,164 @@
+#pragma once
+
+/*
+
+Host (Linux / pthreads) backend.
+
+Maps the subset of the Arduino + FreeRTOS API used by the library onto POSIX
+threads, mutexes, condition variables and the monotonic clock, so the library
+can be built, benchmarked and regression-tested off-device.
+
+Differences to a real FreeRTOS kernel:
+- task priorities are recorded but not enforced
+- `vTaskSuspend` and `vTaskDelete` on another task take effect the next time that
+  task calls into this layer (any blocking call, delay or notification), deleting
+  a task that is already suspended waits until its thread exited
+- one tick is one millisecond (`configTICK_RATE_HZ` is 1000)
+- stack sizes are in bytes, as on the ESP32
+- a task deleting itself exits its thread, which unwinds its stack, so the
+  destructors of its local objects run (FreeRTOS just drops the stack)
+
+Selected by `port.h` when the library is built with `ASYNC_TASKS_HOST` defined,
+see `CMakeLists.txt` in the root of the repository.
+
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <climits>
+#include <string>
+#include <stdexcept>
+
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint8_t StackType_t;
+
+struct _HostTask;
+struct _HostSemaphore;
+struct _HostQueue;
+
+typedef _HostTask* TaskHandle_t;
+typedef _HostSemaphore* SemaphoreHandle_t;
+typedef _HostQueue* QueueHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+// Storage for a statically created task control block
+struct StaticTask_t{
+    alignas(8) uint8_t _storage[64];
+};
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdFAIL pdFALSE
+#define pdPASS pdTRUE
+#define errQUEUE_FULL ((BaseType_t)0)
+#define errQUEUE_EMPTY ((BaseType_t)0)
+
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define configTICK_RATE_HZ 1000
+#define portTICK_PERIOD_MS ((TickType_t)1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((uint64_t)(ms) * (uint64_t)configTICK_RATE_HZ) / (uint64_t)1000U))
+#define pdTICKS_TO_MS(ticks) ((TickType_t)(((uint64_t)(ticks) * (uint64_t)1000U) / (uint64_t)configTICK_RATE_HZ))
+
+// Tick count at startup, as in FreeRTOS, set it just below the wrap around to
+// test the code comparing tick counts
+#ifndef configINITIAL_TICK_COUNT
+#   define configINITIAL_TICK_COUNT 0
+#endif
+
+#define tskIDLE_PRIORITY ((UBaseType_t)0U)
+#define configMAX_PRIORITIES 25
+#define configMAX_TASK_NAME_LEN 16
+#define tskNO_AFFINITY ((BaseType_t)0x7FFFFFFF)
+
+#ifndef portNUM_PROCESSORS
+#   define portNUM_PROCESSORS 2
+#endif
+
+#define configMINIMAL_STACK_SIZE 768
+
+typedef enum{
+    eRunning = 0,
+    eReady,
+    eBlocked,
+    eSuspended,
+    eDeleted,
+    eInvalid
+} eTaskState;
+
+// ---- Tasks ----
+
+BaseType_t xTaskCreatePinnedToCore(
+    TaskFunction_t fn, const char* name, uint32_t stackDepth,
+    void* param, UBaseType_t priority, TaskHandle_t* created, BaseType_t core
+);
+
+BaseType_t xTaskCreate(
+    TaskFunction_t fn, const char* name, uint32_t stackDepth,
+    void* param, UBaseType_t priority, TaskHandle_t* created
+);
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(
+    TaskFunction_t fn, const char* name, uint32_t stackDepth,
+    void* param, UBaseType_t priority, StackType_t* stack,
+    StaticTask_t* tcb, BaseType_t core
+);
+
+TaskHandle_t xTaskCreateStatic(
+    TaskFunction_t fn, const char* name, uint32_t stackDepth,
+    void* param, UBaseType_t priority, StackType_t* stack, StaticTask_t* tcb
+);
+
+void vTaskDelete(TaskHandle_t task);
+void vTaskSuspend(TaskHandle_t task);
+eTaskState eTaskGetState(TaskHandle_t task);
+void vTaskResume(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t* previousWake, TickType_t increment);
+BaseType_t xTaskDelayUntil(TickType_t* previousWake, TickType_t increment);
+TickType_t xTaskGetTickCount();
+TickType_t xTaskGetTickCountFromISR();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+const char* pcTaskGetName(TaskHandle_t task);
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+void vTaskPrioritySet(TaskHandle_t task, UBaseType_t priority);
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task);
+BaseType_t xPortGetCoreID();
+void taskYIELD();
+
+// ---- Direct to task notifications ----
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* higherPriorityTaskWoken);
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait);
+
+// On the host "interrupts" are plain calls from any thread
+#define portYIELD_FROM_ISR(x) do { if (x) { taskYIELD(); } } while (0)
+
+// ---- Semaphores ----
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+SemaphoreHandle_t xSemaphoreCreateBinary();
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t maxCount, UBaseType_t initialCount);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t* higherPriorityTaskWoken);
+void vSemaphoreDelete(SemaphoreHandle_t semaphore);
+
+// ---- Queues ----
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticksToWait);
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void* item, BaseType_t* higherPriorityTaskWoken);
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticksToWait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+void vQueueDelete(QueueHandle_t queue);
+
+// ---- Arduino core ----
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
@@ -5,18 +5,84 @@ BEGIN_TASKS_NAMESPACE
 ScheduleParams& ScheduleParams::every(int amount, TimeUnit unit){
   this->amount = amount;
   this->unit = unit;
+  this->onCalendar = false;
+  return *this;
+}
+
+ScheduleParams& ScheduleParams::at(const cron::Expression& expression){
+  this->calendar = expression;
+  this->onCalendar = true;
+  return *this;
+}
+
+ScheduleParams& ScheduleParams::at(const char* expression){
+  return at(cron::Expression(expression));
+}
+
+ScheduleParams& ScheduleParams::setPolicy(ExecutionPolicy policy){
+  this->policy = policy;
+  return *this;
+}
+
+ScheduleParams& ScheduleParams::setDeadline(int amount, TimeUnit unit){
+  this->deadline = updateTime(0, amount, unit);
+  return *this;
+}
+
+ScheduleParams& ScheduleParams::setBoost(unsigned maxPriority){
+  this->maxPriority = maxPriority;
+  return *this;
+}
+
+ScheduleParams& ScheduleParams::setSlack(int amount, TimeUnit unit){
+  this->slack = updateTime(0, amount, unit);
+  return *this;
+}
+
+ScheduleParams& ScheduleParams::setOverrun(OverrunPolicy overrun){
+  this->overrun = overrun;
+  return *this;
+}
+
+ScheduleParams& ScheduleParams::setOffset(int amount, TimeUnit unit){
+  this->offset = updateTime(0, amount, unit);
   return *this;
 }
 
 using time_point = uint32_t;
 
+time_point ScheduleParams::interval() const{
+  if (onCalendar){
+    return 0;
+  }
+  return updateTime(0, amount, unit);
+}
+
+time_point ScheduleParams::relativeDeadline() const{
+  return deadline ? deadline : interval();
+}
+
 time_point ScheduleParams::schedule(time_point now){
   return updateTime(now, amount, unit);
 }
 
+time_point ScheduleParams::next(time_point planned, time_point now) const{
+  time_point period = interval();
+  if (period == 0){
+    return now;
+  }
+  time_point next = planned + period;
+  if (overrun == OverrunPolicy::CatchUp || int32_t(next - now) > 0){
+    return next;
+  }
+  // behind schedule, jump to the first deadline after now
+  return next + ((now - next) / period + 1) * period;
+}
+
 time_point updateTime(time_point now, int amount, TimeUnit unit){
   using namespace std::chrono;
-  high_resolution_clock::duration multiplier;
+  // an unknown unit counts as milliseconds
+  high_resolution_clock::duration multiplier = milliseconds(1);
   switch(unit){
     case TimeUnit::Milliseconds:
       multiplier = milliseconds(1);
@@ -3,6 +3,7 @@
 #include <ctime>
 #include <chrono>
 #include "namespaces.h"
+#include "cron.h"
 
 BEGIN_TASKS_NAMESPACE
 
@@ -20,22 +21,154 @@ enum class TimeUnit{
   Days = 4,
 };
 
+/*
+
+How the `Scheduler` executes a task when it's due:
+- Spawn: copy the task and `run()` it, creates a new FreeRTOS task for every
+  execution (or submits it to the task's / scheduler's executor), the default
+- Inline: call the task directly on the scheduler task, for tiny jobs,
+  a slow task delays all the others. The job runs without the scheduler's lock,
+  it may add, remove, pause or reschedule jobs, but it must not `stop()` or
+  `pause()` its own scheduler
+- Dedicated: on the first execution, create a long-lived FreeRTOS task (with the
+  task's `TaskParams`), that runs the task in a loop, like `vTaskDelayUntil`. It sleeps
+  on its task notification, so removing or rescheduling the job ends it right after
+  its run in progress, don't rely on notifications sent to it between runs
+- Pooled: submit the stored task to the task's / scheduler's executor (see `TaskPool`),
+  without copying it, falls back to Spawn if there is no executor or it's full
+
+*/
+enum class ExecutionPolicy{
+  Spawn = 0,
+  Inline = 1,
+  Dedicated = 2,
+  Pooled = 3,
+};
+
+/*
+
+What the `Scheduler` does when a task is late by a whole interval or more, so one
+or more of its deadlines already passed. Deadlines are anchored to the first one
+(`now + offset` when the task is added), so a late firing never shifts the next ones:
+- CatchUp: run every missed firing, back to back, until the task is on time again
+- Skip: drop the missed firings, the late one that is due now included, and wait for
+  the next deadline, so the task only ever starts on time (Coalesce is the one running
+  the late firing). A task whose scheduler is always a whole interval or more behind
+  never runs with Skip, the skipped firings show in `TaskStats::skipped`
+- Coalesce: run once for all the missed firings, then continue with the next deadline,
+  the default
+
+Tasks with `ExecutionPolicy::Dedicated` keep their own time with `vTaskDelayUntil`,
+which catches up, except for the deadlines that passed while the task was paused.
+
+*/
+enum class OverrunPolicy{
+  Coalesce = 0,
+  CatchUp = 1,
+  Skip = 2,
+};
+
 struct ScheduleParams{
 
   using time_point = uint32_t;
 
   int amount;
   TimeUnit unit;
+  ExecutionPolicy policy;
+  OverrunPolicy overrun;
+  // delay of the first execution in milliseconds, after the task is added
+  time_point offset;
+  // wall clock schedule, used instead of the interval after `at()`
+  cron::Expression calendar;
+  bool onCalendar;
+  // time a run has to finish in, in milliseconds after its planned start, 0 for the interval
+  time_point deadline;
+  // highest priority a run is raised to as its deadline approaches, 0 for no boost
+  unsigned maxPriority;
+  // how late a run may start in milliseconds, so it's batched with the runs around it
+  time_point slack;
 
-  ScheduleParams(int amount = 60, TimeUnit unit = TimeUnit::Seconds):
-    amount(amount), unit(unit) {}
+  ScheduleParams(int amount = 60, TimeUnit unit = TimeUnit::Seconds, ExecutionPolicy policy = ExecutionPolicy::Spawn):
+    amount(amount), unit(unit), policy(policy), overrun(OverrunPolicy::Coalesce), offset(0),
+    calendar(), onCalendar(false), deadline(0), maxPriority(0), slack(0) {}
 
   /**
    * Schedule the task to be executed every `amount` of `unit`
   */
   ScheduleParams& every(int amount, TimeUnit unit = TimeUnit::Seconds);
 
+  /**
+   * Schedule the task on the wall clock, at the minutes matching the cron expression
+   * (see `cron.h`), in local time. The system time must be set (SNTP, RTC),
+   * the task doesn't run while it's before 2021
+  */
+  ScheduleParams& at(const cron::Expression& expression);
+
+  /**
+   * Parse `expression` and schedule the task at the matching minutes, an invalid
+   * expression never runs, check `calendar.valid()`
+  */
+  ScheduleParams& at(const char* expression);
+
+  /**
+   * Set how the task is executed, see `ExecutionPolicy`
+  */
+  ScheduleParams& setPolicy(ExecutionPolicy policy);
+
+  /**
+   * Set what happens when the task is late by a whole interval, see `OverrunPolicy`
+  */
+  ScheduleParams& setOverrun(OverrunPolicy overrun);
+
+  /**
+   * Delay the first execution by `amount` of `unit` (the phase of the task),
+   * use different offsets for tasks with the same interval, so they don't all
+   * run in the same tick
+  */
+  ScheduleParams& setOffset(int amount, TimeUnit unit = TimeUnit::Milliseconds);
+
+  /**
+   * Set the relative deadline of the runs, `amount` of `unit` after the planned start.
+   * Tasks due in the same tick are started earliest deadline first, the default
+   * deadline is the interval
+  */
+  ScheduleParams& setDeadline(int amount, TimeUnit unit = TimeUnit::Milliseconds);
+
+  /**
+   * Raise the priority of a run that starts late, linearly from the task's
+   * priority (on time) up to `maxPriority` (at the deadline). The run is created
+   * with the raised priority, and a run on an executor raises its worker until it
+   * returns
+  */
+  ScheduleParams& setBoost(unsigned maxPriority);
+
+  /**
+   * Let a run start up to `amount` of `unit` after its deadline (like the timer slack
+   * of Linux), the scheduler wakes up at the latest time all the due runs allow and
+   * runs them in one batch. Keep it below the interval, the next deadline stays
+   * on the grid
+  */
+  ScheduleParams& setSlack(int amount, TimeUnit unit = TimeUnit::Milliseconds);
+
+  /**
+   * The relative deadline in milliseconds, 0 if the task has none
+   * (a cron schedule, or an interval of 0, without `setDeadline()`)
+  */
+  time_point relativeDeadline() const;
+
+  /**
+   * The interval between executions in milliseconds, 0 for a cron schedule
+  */
+  time_point interval() const;
+
   time_point schedule(time_point now);
+
+  /**
+   * The deadline after `planned`, the one that was just executed (or skipped),
+   * on the same grid as `planned`. If it already passed and the policy isn't
+   * `OverrunPolicy::CatchUp`, the first deadline of the grid after `now`
+  */
+  time_point next(time_point planned, time_point now) const;
 };
 
 uint32_t updateTime(uint32_t now, int amount, TimeUnit unit);
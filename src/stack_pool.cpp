@@ -0,0 +1,118 @@
+#include "stack_pool.h"
+
+BEGIN_TASKS_NAMESPACE
+
+// Slot of the task running on the current thread, nullptr if it isn't from a pool
+static thread_local _StackSlot* _currentSlot = nullptr;
+
+BaseStackPool::BaseStackPool(_StackSlot* slots, StackType_t* stacks, uint32_t stackSize, size_t count):
+    _slots(slots), _stacks(stacks), _stackSize(stackSize), _count(count) {}
+
+_StackSlot* BaseStackPool::_take(){
+    for (size_t i = 0; i < _count; i++){
+        _StackSlot& slot = _slots[i];
+        uint8_t state = slot.state.load(std::memory_order_acquire);
+        if (state == _Free && slot.state.compare_exchange_strong(state, _Used, std::memory_order_acquire)){
+            return &slot;
+        }
+        // the previous task may still be on its way to suspending itself
+        if (state != _Done){
+            continue;
+        }
+        TaskHandle_t previous = slot.handle.load(std::memory_order_acquire);
+        if (eTaskGetState(previous) == eSuspended
+            && slot.state.compare_exchange_strong(state, _Used, std::memory_order_acquire)){
+            vTaskDelete(previous);
+            return &slot;
+        }
+    }
+    return nullptr;
+}
+
+TaskHandle_t BaseStackPool::_create(TaskFunction_t fn, const char* name, void* param, UBaseType_t priority, BaseType_t core){
+    _StackSlot* slot = _take();
+    if (!slot){
+        return NULL;
+    }
+    slot->fn = fn;
+    slot->param = param;
+    slot->handle.store(NULL, std::memory_order_relaxed);
+
+    StackType_t* stack = _stacks + size_t(slot - _slots) * _stackSize;
+    TaskHandle_t handle;
+    if (core == tskNO_AFFINITY){
+        handle = xTaskCreateStatic(_entry, name, _stackSize, slot, priority, stack, &slot->tcb);
+    } else {
+        handle = xTaskCreateStaticPinnedToCore(_entry, name, _stackSize, slot, priority, stack, &slot->tcb, core);
+    }
+    if (!handle){
+        slot->state.store(_Free, std::memory_order_release);
+        return NULL;
+    }
+    slot->handle.store(handle, std::memory_order_release);
+    return handle;
+}
+
+void BaseStackPool::_entry(void* param){
+    _StackSlot* slot = static_cast<_StackSlot*>(param);
+    // the task may return before `_create()` stored the handle
+    slot->handle.store(xTaskGetCurrentTaskHandle(), std::memory_order_release);
+    _currentSlot = slot;
+    slot->fn(slot->param);
+    _exitCurrent();
+}
+
+bool BaseStackPool::_release(TaskHandle_t handle){
+    for (size_t i = 0; i < _count; i++){
+        _StackSlot& slot = _slots[i];
+        if (slot.handle.load(std::memory_order_acquire) != handle){
+            continue;
+        }
+        uint8_t state = _Used;
+        if (slot.state.compare_exchange_strong(state, _Killing, std::memory_order_acq_rel)){
+            // `_take()` skips the slot until it's `_Done`, so the handle stays valid
+            vTaskSuspend(handle);
+            slot.state.store(_Done, std::memory_order_release);
+            return true;
+        }
+        // the task already reached `_exitCurrent()`, it suspends itself and `_take()`
+        // deletes it, a pool-owned handle is never deleted outside of the slot
+        if (state == _Done || state == _Killing){
+            return true;
+        }
+    }
+    return false;
+}
+
+void BaseStackPool::_exitCurrent(){
+    _StackSlot* slot = _currentSlot;
+    if (!slot){
+        return;
+    }
+    // if `_release()` is killing the task, it marks the slot `_Done` after suspending it
+    uint8_t state = _Used;
+    slot->state.compare_exchange_strong(state, _Done, std::memory_order_acq_rel);
+    // deleted by the next `_create()` on this slot
+    for (;;){
+        vTaskSuspend(NULL);
+    }
+}
+
+uint32_t BaseStackPool::stackSize() const{
+    return _stackSize;
+}
+
+size_t BaseStackPool::capacity() const{
+    return _count;
+}
+
+size_t BaseStackPool::used() const{
+    size_t count = 0;
+    for (size_t i = 0; i < _count; i++){
+        uint8_t state = _slots[i].state.load(std::memory_order_relaxed);
+        count += state == _Used || state == _Killing ? 1 : 0;
+    }
+    return count;
+}
+
+END_TASKS_NAMESPACE
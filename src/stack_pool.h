@@ -0,0 +1,140 @@
+#pragma once
+
+/*
+
+Preallocated stacks and task control blocks, for tasks created with
+`xTaskCreateStatic`, so starting a task doesn't use the heap.
+
+A task returning from a slot isn't deleted right away: a static task is cleaned
+up by the idle task, and its stack can't be reused before. It marks its slot as
+done and suspends itself, the next task created from that slot deletes it first,
+deleting a suspended task is immediate. A task deleted by someone else is
+suspended the same way.
+
+Slots are taken with compare-and-swap, no lock and no heap. The pool must outlive
+the tasks created from it, usually it's a global.
+
+*/
+
+#include <atomic>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "port.h"
+#include "namespaces.h"
+
+BEGIN_TASKS_NAMESPACE
+
+struct _StackSlot{
+    // _Free, _Used, _Killing or _Done, see `BaseStackPool`
+    std::atomic<uint8_t> state;
+    std::atomic<TaskHandle_t> handle;
+    // entry point and parameter of the task, called by `BaseStackPool::_entry()`
+    TaskFunction_t fn;
+    void* param;
+    StaticTask_t tcb;
+};
+
+/**
+ * Base class of `StackPool`, the stack size and the number of slots are set by
+ * the template, `TaskParams::setStacks()` takes a pointer to this class
+*/
+class BaseStackPool{
+    enum : uint8_t{
+        _Free = 0,
+        _Used = 1,
+        // the task returned or was deleted, it's suspended until the slot is reused
+        _Done = 2,
+        // `_release()` is suspending the task, the slot can't be reused yet
+        _Killing = 3,
+    };
+
+    _StackSlot* _slots;
+    StackType_t* _stacks;
+    uint32_t _stackSize;
+    size_t _count;
+
+    // take a slot, a done one only once its task is suspended
+    _StackSlot* _take();
+
+    static void _entry(void* param);
+
+  protected:
+    BaseStackPool(_StackSlot* slots, StackType_t* stacks, uint32_t stackSize, size_t count);
+
+  public:
+    BaseStackPool(const BaseStackPool&) = delete;
+    BaseStackPool& operator=(const BaseStackPool&) = delete;
+
+    /**
+     * @brief Create a task on a free slot
+     * @param core Core to pin the task to, `tskNO_AFFINITY` for any
+     * @return The handle of the task, NULL if all the slots are used
+    */
+    TaskHandle_t _create(TaskFunction_t fn, const char* name, void* param, UBaseType_t priority, BaseType_t core);
+
+    /**
+     * @brief Give back the slot of a task created from this pool, suspends the task
+     * @return false if the task isn't from this pool
+    */
+    bool _release(TaskHandle_t handle);
+
+    /**
+     * @brief Give back the slot of the current task and suspend it for good,
+     * returns only if the current task isn't from a pool
+    */
+    static void _exitCurrent();
+
+    /**
+     * @brief Stack size of every slot, in `StackType_t` units (bytes on the ESP32)
+    */
+    uint32_t stackSize() const;
+
+    /**
+     * @brief Number of slots
+    */
+    size_t capacity() const;
+
+    /**
+     * @brief Number of slots used by running tasks
+    */
+    size_t used() const;
+};
+
+/*
+
+## StackPool
+
+`_Count` stacks of `_StackSize` (in `StackType_t` units, bytes on the ESP32) and
+their task control blocks. Tasks with `TaskParams::setStacks()` are created on
+them with `xTaskCreateStatic`.
+
+### Example
+
+```cpp
+
+StackPool<4096, 4> stacks;
+
+AsyncTask<> task(TaskParams().setStacks(&stacks), []() {
+  // ...
+});
+task.run();
+```
+*/
+template <uint32_t _StackSize, size_t _Count>
+class StackPool : public BaseStackPool{
+    static_assert(_Count > 0, "StackPool needs at least one slot");
+
+    _StackSlot _slotStorage[_Count];
+    StackType_t _stackStorage[_Count][_StackSize];
+
+  public:
+    StackPool(): BaseStackPool(_slotStorage, &_stackStorage[0][0], _StackSize, _Count){
+        for (size_t i = 0; i < _Count; i++){
+            _slotStorage[i].state.store(0, std::memory_order_relaxed);
+            _slotStorage[i].handle.store(NULL, std::memory_order_relaxed);
+        }
+    }
+};
+
+END_TASKS_NAMESPACE
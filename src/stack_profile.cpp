@@ -0,0 +1,190 @@
+#include "stack_profile.h"
+
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+
+#include "port.h"
+
+// task names are compared as FreeRTOS stores them
+#ifdef configMAX_TASK_NAME_LEN
+#   define _ASYNC_TASKS_NAME_LEN configMAX_TASK_NAME_LEN
+#else
+#   define _ASYNC_TASKS_NAME_LEN 16
+#endif
+
+BEGIN_TASKS_NAMESPACE
+
+namespace {
+
+struct _StackEntry{
+    // hash of the name, 0 if the entry is free
+    std::atomic<uint32_t> hash;
+    // set once `name` is written
+    std::atomic<bool> ready;
+    char name[_ASYNC_TASKS_NAME_LEN];
+    std::atomic<uint32_t> peak;
+    std::atomic<uint32_t> runs;
+};
+
+_StackEntry _entries[ASYNC_TASKS_STACK_PROFILE_SIZE];
+std::atomic<bool> _enabled(true);
+
+// FNV-1a of the name, as long as FreeRTOS keeps it, never 0
+uint32_t _hash(const char* name){
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; name[i] && i < _ASYNC_TASKS_NAME_LEN - 1; i++){
+        hash = (hash ^ uint8_t(name[i])) * 16777619u;
+    }
+    return hash ? hash : 1;
+}
+
+// check the name of an entry with the same hash, two names may collide, waits
+// while the task that claimed the entry is still writing the name
+bool _matches(_StackEntry& entry, uint32_t hash, const char* name){
+    while (!entry.ready.load(std::memory_order_acquire)){
+        // cleared meanwhile
+        if (entry.hash.load(std::memory_order_acquire) != hash){
+            return false;
+        }
+        vTaskDelay(1);
+    }
+    return strncmp(entry.name, name, _ASYNC_TASKS_NAME_LEN - 1) == 0;
+}
+
+// the entry of `name`, claimed if `create` and there is none, open addressing
+_StackEntry* _find(const char* name, bool create){
+    uint32_t hash = _hash(name);
+    for (size_t i = 0; i < ASYNC_TASKS_STACK_PROFILE_SIZE; i++){
+        _StackEntry& entry = _entries[(hash + i) % ASYNC_TASKS_STACK_PROFILE_SIZE];
+        uint32_t current = entry.hash.load(std::memory_order_acquire);
+        if (current == hash && _matches(entry, hash, name)){
+            return &entry;
+        }
+        if (current != 0){
+            continue;
+        }
+        if (!create){
+            return nullptr;
+        }
+        if (entry.hash.compare_exchange_strong(current, hash, std::memory_order_acq_rel)){
+            strncpy(entry.name, name, _ASYNC_TASKS_NAME_LEN - 1);
+            entry.name[_ASYNC_TASKS_NAME_LEN - 1] = '\0';
+            entry.ready.store(true, std::memory_order_release);
+            return &entry;
+        }
+        // someone else took it, maybe for the same name
+        if (current == hash && _matches(entry, hash, name)){
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+void _storePeak(_StackEntry& entry, uint32_t used){
+    uint32_t peak = entry.peak.load(std::memory_order_relaxed);
+    while (used > peak && !entry.peak.compare_exchange_weak(peak, used, std::memory_order_relaxed)) {}
+}
+
+}
+
+void StackProfile::_recordCurrent(uint32_t stackSize){
+    if (!_enabled.load(std::memory_order_relaxed) || stackSize == 0){
+        return;
+    }
+    uint32_t free = uint32_t(uxTaskGetStackHighWaterMark(NULL));
+    record(pcTaskGetName(NULL), stackSize > free ? stackSize - free : 0);
+}
+
+void StackProfile::record(const char* name, uint32_t used){
+    if (!name){
+        return;
+    }
+    _StackEntry* entry = _find(name, true);
+    if (entry){
+        _storePeak(*entry, used);
+        entry->runs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+uint32_t StackProfile::peak(const char* name){
+    _StackEntry* entry = name ? _find(name, false) : nullptr;
+    return entry ? entry->peak.load(std::memory_order_relaxed) : 0;
+}
+
+uint32_t StackProfile::suggest(const char* name, uint32_t stackSize){
+    uint32_t used = peak(name);
+    if (used == 0){
+        return stackSize;
+    }
+    uint32_t margin = used / 4 > ASYNC_TASKS_STACK_MARGIN ? used / 4 : ASYNC_TASKS_STACK_MARGIN;
+    uint32_t size = (used + margin + 15) & ~uint32_t(15);
+    return size < stackSize ? size : stackSize;
+}
+
+size_t StackProfile::snapshot(StackUsage* entries, size_t count){
+    size_t copied = 0;
+    for (size_t i = 0; i < ASYNC_TASKS_STACK_PROFILE_SIZE && copied < count; i++){
+        _StackEntry& entry = _entries[i];
+        if (!entry.ready.load(std::memory_order_acquire)){
+            continue;
+        }
+        entries[copied].name = entry.name;
+        entries[copied].peak = entry.peak.load(std::memory_order_relaxed);
+        entries[copied].runs = entry.runs.load(std::memory_order_relaxed);
+        copied++;
+    }
+    return copied;
+}
+
+size_t StackProfile::exportTo(char* buffer, size_t size){
+    size_t length = 0;
+    // appends like snprintf, counts the full length even when the buffer is full
+    auto append = [&](const char* format, const char* name, unsigned long peak, unsigned long runs){
+        char* target = length < size ? buffer + length : nullptr;
+        int written = snprintf(target, target ? size - length : 0, format, name, peak, runs);
+        length += written > 0 ? size_t(written) : 0;
+    };
+
+    append("%sconst StackUsage stackProfile[] = {\n", "", 0, 0);
+    for (size_t i = 0; i < ASYNC_TASKS_STACK_PROFILE_SIZE; i++){
+        _StackEntry& entry = _entries[i];
+        if (!entry.ready.load(std::memory_order_acquire)){
+            continue;
+        }
+        append("    {\"%s\", %lu, %lu},\n", entry.name,
+            (unsigned long)entry.peak.load(std::memory_order_relaxed),
+            (unsigned long)entry.runs.load(std::memory_order_relaxed));
+    }
+    append("%s};\n", "", 0, 0);
+    return length;
+}
+
+void StackProfile::load(const StackUsage* entries, size_t count){
+    for (size_t i = 0; i < count; i++){
+        _StackEntry* entry = entries[i].name ? _find(entries[i].name, true) : nullptr;
+        if (entry){
+            _storePeak(*entry, entries[i].peak);
+        }
+    }
+}
+
+void StackProfile::clear(){
+    for (size_t i = 0; i < ASYNC_TASKS_STACK_PROFILE_SIZE; i++){
+        _StackEntry& entry = _entries[i];
+        entry.ready.store(false, std::memory_order_relaxed);
+        entry.peak.store(0, std::memory_order_relaxed);
+        entry.runs.store(0, std::memory_order_relaxed);
+        entry.hash.store(0, std::memory_order_release);
+    }
+}
+
+void StackProfile::setEnabled(bool enabled){
+    _enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool StackProfile::enabled(){
+    return _enabled.load(std::memory_order_relaxed);
+}
+
+END_TASKS_NAMESPACE
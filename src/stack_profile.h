@@ -0,0 +1,131 @@
+#pragma once
+
+/*
+
+Stack usage profile of the tasks started by `AsyncTask::run()`.
+
+When a task that ran on its own FreeRTOS task returns, its stack high water mark
+(`uxTaskGetStackHighWaterMark`) is turned into the stack it used, and the peak is
+kept per task name, in a fixed table of `ASYNC_TASKS_STACK_PROFILE_SIZE` names.
+Recording is lock-free and doesn't use the heap, names that don't fit into the
+table aren't recorded. Jobs on an `Executor` run on the executor's stacks and
+aren't recorded.
+
+Sizes are in the unit of `TaskParams::stackSize`: bytes on the ESP32, words on
+vanilla FreeRTOS.
+
+Tasks with `TaskParams::setAutoStackSize(true)` are created with the peak of their
+name plus a margin (a quarter of the peak, at least `ASYNC_TASKS_STACK_MARGIN`),
+never more than their `stackSize`, which is also used until their name has a peak.
+The profile can be exported as C++ source with `StackProfile::exportTo()` and
+loaded at startup with `StackProfile::load()`, so release builds start with the
+sizes measured during development.
+
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "namespaces.h"
+
+#ifndef ASYNC_TASKS_STACK_PROFILE_SIZE
+#   define ASYNC_TASKS_STACK_PROFILE_SIZE 32
+#endif
+
+#ifndef ASYNC_TASKS_STACK_MARGIN
+#   define ASYNC_TASKS_STACK_MARGIN 512
+#endif
+
+BEGIN_TASKS_NAMESPACE
+
+/**
+ * Stack usage recorded for one task name
+*/
+struct StackUsage{
+    // name of the task, as FreeRTOS stores it (might be truncated)
+    const char* name;
+    // the most stack a run used
+    uint32_t peak;
+    // number of runs recorded
+    uint32_t runs;
+};
+
+/*
+
+## StackProfile
+
+### Example
+
+```cpp
+
+// once the tasks ran for a while, print the profile
+char buffer[1024];
+StackProfile::exportTo(buffer, sizeof(buffer));
+Serial.print(buffer);
+
+// in the release build, paste the output and load it in `setup()`
+const StackUsage stackProfile[] = {
+    {"Sensor", 1320, 40},
+};
+StackProfile::load(stackProfile, 1);
+
+AsyncTask<> task(TaskParams(4096, 1, "Sensor").setAutoStackSize(true), readSensor);
+task.run(); // created with 1840 bytes of stack
+```
+*/
+class StackProfile{
+  public:
+    /**
+     * @brief Record the stack usage of the current task, called when it returns
+     * @param stackSize Stack size the task was created with
+    */
+    static void _recordCurrent(uint32_t stackSize);
+
+    /**
+     * @brief Record a run of `name` that used `used` of its stack
+    */
+    static void record(const char* name, uint32_t used);
+
+    /**
+     * @brief Stack size for a new task named `name`, its peak plus a margin,
+     * at most `stackSize`, which is returned if the name has no peak yet
+    */
+    static uint32_t suggest(const char* name, uint32_t stackSize);
+
+    /**
+     * @brief The peak of `name`, 0 if none was recorded
+    */
+    static uint32_t peak(const char* name);
+
+    /**
+     * @brief Copy the recorded names, at most `count`
+     * @return The number of entries copied
+    */
+    static size_t snapshot(StackUsage* entries, size_t count);
+
+    /**
+     * @brief Write the profile as a C++ array of `StackUsage`, to be passed to `load()`
+     * @return Length of the full text, like `snprintf`, the text is cut if it's
+     * `size` or longer
+    */
+    static size_t exportTo(char* buffer, size_t size);
+
+    /**
+     * @brief Merge a profile into the recorded one, the larger peak of every name is kept
+    */
+    static void load(const StackUsage* entries, size_t count);
+
+    /**
+     * @brief Forget all the names, must not be called while tasks are returning
+    */
+    static void clear();
+
+    /**
+     * @brief Turn recording on or off, it's on by default, `suggest()` keeps using
+     * the recorded and loaded peaks
+    */
+    static void setEnabled(bool enabled);
+    static bool enabled();
+};
+
+END_TASKS_NAMESPACE
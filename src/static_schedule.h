@@ -0,0 +1,388 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "./Scheduler.h"
+
+// largest number of frames in the hyperperiod of a `StaticSchedule`, every frame
+// takes 4 bytes of flash
+#ifndef ASYNC_TASKS_STATIC_FRAMES
+#   define ASYNC_TASKS_STATIC_FRAMES 1024
+#endif
+
+BEGIN_TASKS_NAMESPACE
+
+/*
+
+## StaticJob
+
+A job of a `StaticSchedule`: `_Fn` runs every `_Period` milliseconds, first `_Offset`
+milliseconds after the start (`_Offset < _Period`). With `ExecutionPolicy::Inline`
+it's called on the schedule's task, with `ExecutionPolicy::Pooled` it's submitted to
+the schedule's executor (or called inline if there is none or it's full).
+
+*/
+template <void (*_Fn)(), uint32_t _Period, uint32_t _Offset = 0, ExecutionPolicy _Policy = ExecutionPolicy::Inline>
+struct StaticJob{
+  static_assert(_Period > 0, "StaticJob period must be at least 1 ms");
+  static_assert(_Offset < _Period, "StaticJob offset must be shorter than its period");
+  static_assert(_Policy == ExecutionPolicy::Inline || _Policy == ExecutionPolicy::Pooled,
+    "StaticJob runs Inline or Pooled");
+
+  static constexpr uint32_t period = _Period;
+  static constexpr uint32_t offset = _Offset;
+  static constexpr bool pooled = _Policy == ExecutionPolicy::Pooled;
+
+  static void _call(void*){
+    _Fn();
+  }
+};
+
+// compile-time integer sequence, built in log(N) steps so long tables don't hit
+// the template depth limit (`make_index_sequence` in `tuple.h` is linear)
+template <size_t... _Is>
+struct _Seq{};
+
+template <typename _A, typename _B>
+struct _SeqConcat;
+
+template <size_t... _As, size_t... _Bs>
+struct _SeqConcat<_Seq<_As...>, _Seq<_Bs...>>{
+  using type = _Seq<_As..., (sizeof...(_As) + _Bs)...>;
+};
+
+template <size_t _N>
+struct _MakeSeq{
+  using type = typename _SeqConcat<typename _MakeSeq<_N / 2>::type, typename _MakeSeq<_N - _N / 2>::type>::type;
+};
+
+template <>
+struct _MakeSeq<0>{
+  using type = _Seq<>;
+};
+
+template <>
+struct _MakeSeq<1>{
+  using type = _Seq<0>;
+};
+
+constexpr uint64_t _gcd(uint64_t a, uint64_t b){
+  return b == 0 ? a : _gcd(b, a % b);
+}
+
+constexpr uint64_t _lcm(uint64_t a, uint64_t b){
+  return a / _gcd(a, b) * b;
+}
+
+// jobs due in every frame of the hyperperiod, bit `r` is the job of rank `r`
+template <typename _Schedule, typename _Frames>
+struct _FrameTable;
+
+template <typename _Schedule, size_t... _Is>
+struct _FrameTable<_Schedule, _Seq<_Is...>>{
+  static constexpr uint32_t masks[sizeof...(_Is)] = {_Schedule::_maskOf(_Is)...};
+};
+
+template <typename _Schedule, size_t... _Is>
+constexpr uint32_t _FrameTable<_Schedule, _Seq<_Is...>>::masks[sizeof...(_Is)];
+
+// job index of every rank
+template <typename _Schedule, typename _Ranks>
+struct _RankTable;
+
+template <typename _Schedule, size_t... _Is>
+struct _RankTable<_Schedule, _Seq<_Is...>>{
+  static constexpr uint8_t jobs[sizeof...(_Is)] = {_Schedule::_jobOfRank(_Is)...};
+};
+
+template <typename _Schedule, size_t... _Is>
+constexpr uint8_t _RankTable<_Schedule, _Seq<_Is...>>::jobs[sizeof...(_Is)];
+
+/*
+
+## StaticSchedule
+
+A cyclic executive for jobs known at build time. The table is computed by the
+compiler: the frame length is the greatest common divisor of the periods and
+offsets, the hyperperiod their least common multiple, and every frame of the
+hyperperiod gets a bitmask of the jobs due in it. Dispatching a frame walks the
+bits of one word and calls plain function pointers, no type erasure, no heap,
+and nothing to register at startup.
+
+Jobs due in the same frame run rate monotonic: shortest period first, in the
+order of declaration for equal periods.
+
+The schedule runs either on its own task (`run()`), which sleeps until the next
+frame with jobs, or as one `Inline` job of a dynamic `Scheduler` (`addTo()`),
+next to the jobs added at runtime.
+
+
+### Example
+
+```cpp
+
+void readSensors();
+void control();
+void log();
+
+StaticSchedule<
+  StaticJob<readSensors, 10>,
+  StaticJob<control, 20, 5>,
+  StaticJob<log, 1000, 0, ExecutionPolicy::Pooled>
+> table; // 5 ms frames, 200 frames
+
+table.run();
+// or, with the jobs added at runtime
+table.addTo(scheduler);
+```
+*/
+template <typename... _Jobs>
+class StaticSchedule
+{
+  static_assert(sizeof...(_Jobs) > 0, "StaticSchedule needs at least one job");
+  static_assert(sizeof...(_Jobs) <= 32, "StaticSchedule has at most 32 jobs");
+
+  public:
+  static constexpr size_t jobCount = sizeof...(_Jobs);
+
+  // `_` prefixed constexpr members are used to build the tables
+
+  static constexpr uint32_t _periods[jobCount] = {_Jobs::period...};
+  static constexpr uint32_t _offsets[jobCount] = {_Jobs::offset...};
+  static constexpr bool _pooled[jobCount] = {_Jobs::pooled...};
+  static constexpr _JobFunction _calls[jobCount] = {&_Jobs::_call...};
+
+  static constexpr uint64_t _frameFrom(size_t job){
+    return job == jobCount ? 0 : _gcd(_gcd(_periods[job], _offsets[job]), _frameFrom(job + 1));
+  }
+
+  static constexpr uint64_t _hyperperiodFrom(size_t job){
+    return job == jobCount ? 1 : _lcm(_periods[job], _hyperperiodFrom(job + 1));
+  }
+
+  // number of jobs that run before `job` in a frame
+  static constexpr size_t _rankFrom(size_t job, size_t other){
+    return other == jobCount ? 0
+      : (_periods[other] < _periods[job] || (_periods[other] == _periods[job] && other < job) ? 1 : 0)
+        + _rankFrom(job, other + 1);
+  }
+
+  static constexpr uint8_t _jobOfRankFrom(size_t rank, size_t job){
+    return job == jobCount || _rankFrom(job, 0) == rank ? uint8_t(job) : _jobOfRankFrom(rank, job + 1);
+  }
+
+  static constexpr uint8_t _jobOfRank(size_t rank){
+    return _jobOfRankFrom(rank, 0);
+  }
+
+  static constexpr bool _due(size_t job, uint64_t time){
+    return (time + _periods[job] - _offsets[job]) % _periods[job] == 0;
+  }
+
+  static constexpr uint32_t _maskFrom(size_t frame, size_t job){
+    return job == jobCount ? 0
+      : (_due(job, uint64_t(frame) * _frameFrom(0)) ? uint32_t(1) << _rankFrom(job, 0) : 0) | _maskFrom(frame, job + 1);
+  }
+
+  static constexpr uint32_t _maskOf(size_t frame){
+    return _maskFrom(frame, 0);
+  }
+
+  /**
+   * @brief Length of a frame in milliseconds, every job is due at the start of a frame
+  */
+  static constexpr uint32_t frameLength = uint32_t(_frameFrom(0));
+
+  /**
+   * @brief Length of the whole table in milliseconds, it repeats after that
+  */
+  static constexpr uint64_t hyperperiod = _hyperperiodFrom(0);
+
+  /**
+   * @brief Number of frames in the hyperperiod
+  */
+  static constexpr size_t frameCount = size_t(hyperperiod / frameLength);
+
+  static_assert(hyperperiod / frameLength <= ASYNC_TASKS_STATIC_FRAMES,
+    "StaticSchedule hyperperiod has too many frames, align the periods or raise ASYNC_TASKS_STATIC_FRAMES");
+
+  private:
+  using _Frames = _FrameTable<StaticSchedule, typename _MakeSeq<frameCount>::type>;
+  using _Ranks = _RankTable<StaticSchedule, typename _MakeSeq<jobCount>::type>;
+
+  // next frame to dispatch, in the hyperperiod
+  uint32_t _frame;
+  Executor* _executor;
+  TaskParams _params;
+  TaskHandle_t _handle;
+  std::atomic<bool> _stopping;
+  std::atomic<bool> _running;
+  // frames dispatched after the start of the next one
+  std::atomic<uint32_t> _overruns;
+
+  static void _taskRunner(void* param){
+    StaticSchedule* self = static_cast<StaticSchedule*>(param);
+    // start of the frame `_frame`, in milliseconds of the tick count
+    uint32_t frameStart = pdTICKS_TO_MS(xTaskGetTickCount());
+    while (!self->_stopping.load()){
+      // sleep over the frames without jobs
+      while (_Frames::masks[self->_frame] == 0){
+        self->_frame = self->_frame + 1 < frameCount ? self->_frame + 1 : 0;
+        frameStart += frameLength;
+      }
+      int32_t wait = int32_t(frameStart - pdTICKS_TO_MS(xTaskGetTickCount()));
+      if (wait > 0){
+        // woken early by `stop()`
+        ulTaskNotifyTake(pdTRUE, std::max<TickType_t>(pdMS_TO_TICKS(wait), 1));
+        continue;
+      }
+      if (uint32_t(-wait) >= frameLength){
+        self->_overruns.fetch_add(1, std::memory_order_relaxed);
+      }
+      self->step();
+      frameStart += frameLength;
+    }
+    self->_running.store(false);
+    BaseAsyncTask::_exitTask();
+  }
+
+  public:
+  StaticSchedule(): _frame(0), _executor(nullptr), _params(), _handle(NULL),
+    _stopping(false), _running(false), _overruns(0) {}
+
+  StaticSchedule(const StaticSchedule&) = delete;
+  StaticSchedule& operator=(const StaticSchedule&) = delete;
+
+  ~StaticSchedule(){
+    stop();
+  }
+
+  /**
+   * @brief Jobs due in `frame`, bit `r` is the `r`th job in the dispatch order
+  */
+  static uint32_t dueMask(size_t frame){
+    return _Frames::masks[frame % frameCount];
+  }
+
+  /**
+   * @brief Index in the template arguments of the `rank`th job in the dispatch order
+  */
+  static size_t jobOfRank(size_t rank){
+    return _Ranks::jobs[rank];
+  }
+
+  /**
+   * @brief Set the executor the `Pooled` jobs are submitted to
+   * @return *this
+  */
+  StaticSchedule& setExecutor(Executor* executor){
+    _executor = executor;
+    return *this;
+  }
+
+  /**
+   * @brief Set the parameters of the task started by `run()`
+   * @return *this
+  */
+  StaticSchedule& setParams(const TaskParams& params){
+    _params = params;
+    return *this;
+  }
+
+  /**
+   * @brief Dispatch the jobs of the current frame on the calling task and move to the next frame,
+   * called by the task of `run()` and by the job of `addTo()`
+  */
+  void step(){
+    uint32_t mask = _Frames::masks[_frame];
+    while (mask){
+      size_t job = _Ranks::jobs[__builtin_ctz(mask)];
+      mask &= mask - 1;
+      if (!_pooled[job] || !_executor || !_executor->submit(_calls[job], nullptr)){
+        _calls[job](nullptr);
+      }
+    }
+    _frame = _frame + 1 < frameCount ? _frame + 1 : 0;
+  }
+
+  /**
+   * @brief Start the table on its own task, created with the parameters of `setParams()`
+  */
+  void run(){
+    if (_running.exchange(true)){
+      return;
+    }
+    _stopping.store(false);
+    _frame = 0;
+    _handle = BaseAsyncTask::_createTask(
+      _taskRunner, _params.name, _params.stackSize, this, _params.priority, _params
+    );
+    if (!_handle){
+      _running.store(false);
+    }
+  }
+
+  /**
+   * @brief Stop the task of `run()`, waits until it returned, the jobs of the frame
+   * being dispatched finish first
+  */
+  void stop(){
+    if (!_running.load()){
+      return;
+    }
+    _stopping.store(true);
+    xTaskNotifyGive(_handle);
+    while (_running.load()){
+      vTaskDelay(1);
+    }
+    _handle = NULL;
+  }
+
+  /**
+   * @brief Run the table as one `Inline` job of `scheduler`, every frame, catching up
+   * on missed frames, so the frames keep their order
+   * @return Handle of the job
+  */
+  JobHandle addTo(Scheduler& scheduler){
+    _frame = 0;
+    return scheduler.addTask([this](){ step(); }, ScheduleParams(int(frameLength), TimeUnit::Milliseconds)
+      .setPolicy(ExecutionPolicy::Inline)
+      .setOverrun(OverrunPolicy::CatchUp));
+  }
+
+  /**
+   * @brief Number of frames the task of `run()` started a whole frame late
+  */
+  uint32_t overruns() const{
+    return _overruns.load(std::memory_order_relaxed);
+  }
+};
+
+template <typename... _Jobs>
+constexpr uint32_t StaticSchedule<_Jobs...>::_periods[];
+
+template <typename... _Jobs>
+constexpr uint32_t StaticSchedule<_Jobs...>::_offsets[];
+
+template <typename... _Jobs>
+constexpr bool StaticSchedule<_Jobs...>::_pooled[];
+
+template <typename... _Jobs>
+constexpr _JobFunction StaticSchedule<_Jobs...>::_calls[];
+
+template <typename... _Jobs>
+constexpr size_t StaticSchedule<_Jobs...>::jobCount;
+
+template <typename... _Jobs>
+constexpr uint32_t StaticSchedule<_Jobs...>::frameLength;
+
+template <typename... _Jobs>
+constexpr uint64_t StaticSchedule<_Jobs...>::hyperperiod;
+
+template <typename... _Jobs>
+constexpr size_t StaticSchedule<_Jobs...>::frameCount;
+
+END_TASKS_NAMESPACE
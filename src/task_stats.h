@@ -0,0 +1,184 @@
+#pragma once
+
+/*
+
+Timing statistics of a scheduled task.
+
+Every counter is a relaxed atomic updated by the task that runs the job (or the
+scheduler task, for skipped firings), so recording takes a few atomic adds and two
+clock reads, never a lock. A snapshot is read counter by counter, so it can be
+off by a run that is in progress while it's taken.
+
+The lateness histogram has `ASYNC_TASKS_LATENESS_BUCKETS` buckets, bucket 0 counts
+the firings that started on time (in the same millisecond), bucket `i` the ones
+that started 2^(i-1) to 2^i - 1 milliseconds late, the last one everything later.
+
+*/
+
+#include <atomic>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "namespaces.h"
+
+#ifndef ASYNC_TASKS_LATENESS_BUCKETS
+#   define ASYNC_TASKS_LATENESS_BUCKETS 12
+#endif
+
+BEGIN_TASKS_NAMESPACE
+
+/**
+ * Snapshot of the timing statistics of a scheduled task
+*/
+struct TaskStats{
+    // number of times the task was started
+    uint32_t firings;
+    // number of times the task returned
+    uint32_t completed;
+    // deadlines missed entirely, because the previous firing was a whole interval late or more
+    uint32_t skipped;
+    // firings started while the previous run of the task was still going
+    uint32_t overlaps;
+    // runs that returned after their deadline
+    uint32_t deadlineMisses;
+    // runs in progress right now
+    uint32_t running;
+    // lateness histogram, see `task_stats.h`
+    uint32_t lateness[ASYNC_TASKS_LATENESS_BUCKETS];
+    // the latest start, in milliseconds after the planned time
+    uint32_t maxLateness;
+    // execution time of the completed runs, in microseconds
+    uint32_t minDuration;
+    uint32_t avgDuration;
+    uint32_t maxDuration;
+};
+
+class _TaskCounters{
+    std::atomic<uint32_t> _firings;
+    std::atomic<uint32_t> _completed;
+    std::atomic<uint32_t> _skipped;
+    std::atomic<uint32_t> _overlaps;
+    std::atomic<uint32_t> _deadlineMisses;
+    std::atomic<uint32_t> _running;
+    std::atomic<uint32_t> _lateness[ASYNC_TASKS_LATENESS_BUCKETS];
+    std::atomic<uint32_t> _maxLateness;
+    std::atomic<uint32_t> _minDuration;
+    std::atomic<uint32_t> _maxDuration;
+    // total execution time in microseconds, split in two words, 64-bit atomics
+    // aren't lock-free on 32-bit cores
+    std::atomic<uint32_t> _durationLow;
+    std::atomic<uint32_t> _durationHigh;
+
+    static void _storeMax(std::atomic<uint32_t>& target, uint32_t value){
+        uint32_t current = target.load(std::memory_order_relaxed);
+        while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+    }
+
+    static void _storeMin(std::atomic<uint32_t>& target, uint32_t value){
+        uint32_t current = target.load(std::memory_order_relaxed);
+        while (value < current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+    }
+
+    static size_t _bucket(uint32_t lateness){
+        size_t bucket = 0;
+        while (lateness && bucket + 1 < ASYNC_TASKS_LATENESS_BUCKETS){
+            lateness >>= 1;
+            bucket++;
+        }
+        return bucket;
+    }
+
+public:
+    _TaskCounters(): _running(0){
+        reset();
+    }
+
+    _TaskCounters(const _TaskCounters&): _TaskCounters() {}
+
+    /**
+     * @brief Record the start of a run
+     * @param lateness Milliseconds since the planned start
+    */
+    void _start(uint32_t lateness){
+        _firings.fetch_add(1, std::memory_order_relaxed);
+        if (_running.fetch_add(1, std::memory_order_relaxed) > 0){
+            _overlaps.fetch_add(1, std::memory_order_relaxed);
+        }
+        _lateness[_bucket(lateness)].fetch_add(1, std::memory_order_relaxed);
+        _storeMax(_maxLateness, lateness);
+    }
+
+    /**
+     * @brief Record the end of a run
+     * @param duration Execution time in microseconds
+    */
+    void _end(uint32_t duration){
+        uint32_t low = _durationLow.fetch_add(duration, std::memory_order_relaxed);
+        if (uint32_t(low + duration) < low){
+            _durationHigh.fetch_add(1, std::memory_order_relaxed);
+        }
+        _storeMin(_minDuration, duration);
+        _storeMax(_maxDuration, duration);
+        _completed.fetch_add(1, std::memory_order_relaxed);
+        _running.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Record deadlines that were skipped
+    */
+    void _skip(uint32_t count){
+        _skipped.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Record a run that returned after its deadline
+    */
+    void _miss(){
+        _deadlineMisses.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void reset(){
+        _firings.store(0, std::memory_order_relaxed);
+        _completed.store(0, std::memory_order_relaxed);
+        _skipped.store(0, std::memory_order_relaxed);
+        _overlaps.store(0, std::memory_order_relaxed);
+        _deadlineMisses.store(0, std::memory_order_relaxed);
+        // `_running` is left alone, it counts the runs in progress, not past ones
+        for (size_t i = 0; i < ASYNC_TASKS_LATENESS_BUCKETS; i++){
+            _lateness[i].store(0, std::memory_order_relaxed);
+        }
+        _maxLateness.store(0, std::memory_order_relaxed);
+        _minDuration.store(UINT32_MAX, std::memory_order_relaxed);
+        _maxDuration.store(0, std::memory_order_relaxed);
+        _durationLow.store(0, std::memory_order_relaxed);
+        _durationHigh.store(0, std::memory_order_relaxed);
+    }
+
+    TaskStats snapshot() const{
+        TaskStats stats;
+        stats.firings = _firings.load(std::memory_order_relaxed);
+        stats.completed = _completed.load(std::memory_order_relaxed);
+        stats.skipped = _skipped.load(std::memory_order_relaxed);
+        stats.overlaps = _overlaps.load(std::memory_order_relaxed);
+        stats.deadlineMisses = _deadlineMisses.load(std::memory_order_relaxed);
+        stats.running = _running.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < ASYNC_TASKS_LATENESS_BUCKETS; i++){
+            stats.lateness[i] = _lateness[i].load(std::memory_order_relaxed);
+        }
+        stats.maxLateness = _maxLateness.load(std::memory_order_relaxed);
+
+        uint32_t high, low;
+        do {
+            high = _durationHigh.load(std::memory_order_relaxed);
+            low = _durationLow.load(std::memory_order_relaxed);
+        } while (high != _durationHigh.load(std::memory_order_relaxed));
+        uint64_t total = (uint64_t(high) << 32) | low;
+
+        stats.minDuration = stats.completed ? _minDuration.load(std::memory_order_relaxed) : 0;
+        stats.maxDuration = _maxDuration.load(std::memory_order_relaxed);
+        stats.avgDuration = stats.completed ? uint32_t(total / stats.completed) : 0;
+        return stats;
+    }
+};
+
+END_TASKS_NAMESPACE
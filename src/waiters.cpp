@@ -0,0 +1,76 @@
+#include "waiters.h"
+
+BEGIN_TASKS_NAMESPACE
+
+_TaskWaiters::_TaskWaiters(){
+    for (size_t i = 0; i < ASYNC_TASKS_WAITERS; i++){
+        _tasks[i].store(NULL, std::memory_order_relaxed);
+    }
+}
+
+int _TaskWaiters::_add(){
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    int slot = -1;
+    for (size_t i = 0; i < ASYNC_TASKS_WAITERS && slot < 0; i++){
+        TaskHandle_t empty = NULL;
+        if (_tasks[i].compare_exchange_strong(empty, self)){
+            slot = int(i);
+        }
+    }
+    // pairs with the fence in `_wakeOne()`
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return slot;
+}
+
+void _TaskWaiters::_sleep(int slot, TickType_t ticks){
+    if (slot < 0){
+        vTaskDelay(1);
+        return;
+    }
+    _remove(slot, ulTaskNotifyTake(pdTRUE, ticks) != 0);
+}
+
+void _TaskWaiters::_remove(int slot, bool notified){
+    if (slot < 0){
+        return;
+    }
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    // If a waker already took us out, its notification is sent or about to be, consume it
+    if (!_tasks[slot].compare_exchange_strong(self, NULL) && !notified){
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+}
+
+bool _TaskWaiters::_notify(size_t slot){
+    TaskHandle_t task = _tasks[slot].exchange(NULL);
+    if (!task){
+        return false;
+    }
+    xTaskNotifyGive(task);
+    return true;
+}
+
+bool _TaskWaiters::_wakeOneFromISR(BaseType_t* woken){
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (size_t i = 0; i < ASYNC_TASKS_WAITERS; i++){
+        TaskHandle_t task = _tasks[i].load(std::memory_order_relaxed) ? _tasks[i].exchange(NULL) : NULL;
+        if (task){
+            vTaskNotifyGiveFromISR(task, woken);
+            return true;
+        }
+    }
+    return false;
+}
+
+void _TaskWaiters::_wakeAll(){
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (size_t i = 0; i < ASYNC_TASKS_WAITERS; i++){
+        _notify(i);
+    }
+}
+
+void _TaskWaiters::_wakeAllFromISR(BaseType_t* woken){
+    while (_wakeOneFromISR(woken)) {}
+}
+
+END_TASKS_NAMESPACE
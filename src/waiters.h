@@ -0,0 +1,92 @@
+#pragma once
+
+/*
+
+Registry of the tasks blocked on a lock-free structure (a side of a `Channel`,
+the hidden jobs of a `TaskPool`), woken with their task notification.
+
+A task puts its handle into a free slot, checks the structure again, and sleeps
+on its task notification, whoever takes the handle out of the slot sends the
+notification, so it's sent at most once. Waking is a fence and a scan of the
+slots, so the side that makes progress doesn't make a kernel call unless a task
+is actually blocked.
+
+*/
+
+#include <atomic>
+#include <stddef.h>
+
+#include "port.h"
+#include "namespaces.h"
+
+// tasks per registry (a side of a `Channel`, the workers of a `TaskPool`) woken by
+// a notification when they block, more blocked tasks check again every tick
+#ifndef ASYNC_TASKS_WAITERS
+#   define ASYNC_TASKS_WAITERS 4
+#endif
+
+BEGIN_TASKS_NAMESPACE
+
+class _TaskWaiters{
+    std::atomic<TaskHandle_t> _tasks[ASYNC_TASKS_WAITERS];
+
+    // take the task out of `slot` and notify it, false if it was already gone
+    bool _notify(size_t slot);
+
+  public:
+    _TaskWaiters();
+
+    _TaskWaiters(const _TaskWaiters&) = delete;
+    _TaskWaiters& operator=(const _TaskWaiters&) = delete;
+
+    /**
+     * @brief Register the current task, check the structure again after this
+     * @return The slot of the task, -1 if all are used
+    */
+    int _add();
+
+    /**
+     * @brief Block until the task is notified or `ticks` pass, and unregister it
+     * @param slot Returned by `_add()`, with -1 waits for a tick at most
+    */
+    void _sleep(int slot, TickType_t ticks);
+
+    /**
+     * @brief Unregister the task without blocking, consumes the notification if it was
+     * already woken up, so it doesn't wake up a later, unrelated wait of the task
+    */
+    void _remove(int slot, bool notified);
+
+    /**
+     * @brief Wake up one blocked task, if any, cheap when no task is blocked
+     * @return true if a task was woken up
+    */
+    bool _wakeOne(){
+        // pairs with the fence in `_add()`, either the waiter sees the change to the
+        // structure, or we see the waiter
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for (size_t i = 0; i < ASYNC_TASKS_WAITERS; i++){
+            if (_tasks[i].load(std::memory_order_relaxed) && _notify(i)){
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Same as `_wakeOne()`, from an interrupt handler
+    */
+    bool _wakeOneFromISR(BaseType_t* woken);
+
+    /**
+     * @brief Wake up all the blocked tasks
+    */
+    void _wakeAll();
+
+    /**
+     * @brief Same as `_wakeAll()`, from an interrupt handler
+    */
+    void _wakeAllFromISR(BaseType_t* woken);
+};
+
+END_TASKS_NAMESPACE
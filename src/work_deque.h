@@ -0,0 +1,128 @@
+#pragma once
+
+/*
+
+Fixed-capacity Chase-Lev work-stealing deque.
+
+The owning worker pushes and pops jobs at the bottom (LIFO, keeps the cache warm),
+other workers steal from the top (FIFO, oldest and usually biggest jobs first).
+All operations are lock-free, the owner's push and pop don't even need a
+compare-and-swap unless they race for the last item.
+
+*/
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "namespaces.h"
+#include "Executor.h"
+
+BEGIN_TASKS_NAMESPACE
+
+class _WorkDeque{
+    // Function and argument are stored separately, a stealer might read a slot that
+    // is being overwritten, but then its compare-and-swap on `_top` fails and the
+    // read is discarded
+    std::unique_ptr<std::atomic<_JobFunction>[]> _fns;
+    std::unique_ptr<std::atomic<void*>[]> _args;
+    uint32_t _mask;
+    std::atomic<uint32_t> _top;
+    std::atomic<uint32_t> _bottom;
+
+public:
+    /**
+     * @brief Create the deque, capacity is rounded up to a power of 2
+    */
+    explicit _WorkDeque(size_t capacity): _fns(), _args(), _mask(0), _top(0), _bottom(0){
+        uint32_t size = 2;
+        while (size < capacity){
+            size <<= 1;
+        }
+        _fns.reset(new std::atomic<_JobFunction>[size]);
+        _args.reset(new std::atomic<void*>[size]);
+        _mask = size - 1;
+    }
+
+    _WorkDeque(const _WorkDeque&) = delete;
+    _WorkDeque& operator=(const _WorkDeque&) = delete;
+
+    /**
+     * @brief Push a job at the bottom, only the owner may call it
+     * @return false if the deque is full
+    */
+    bool push(_JobFunction fn, void* arg){
+        uint32_t b = _bottom.load(std::memory_order_relaxed);
+        uint32_t t = _top.load(std::memory_order_acquire);
+        if (b - t > _mask){
+            return false;
+        }
+        _fns[b & _mask].store(fn, std::memory_order_relaxed);
+        _args[b & _mask].store(arg, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        _bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * @brief Pop the newest job, only the owner may call it
+     * @return false if the deque is empty
+    */
+    bool pop(_JobFunction& fn, void*& arg){
+        uint32_t b = _bottom.load(std::memory_order_relaxed) - 1;
+        _bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint32_t t = _top.load(std::memory_order_relaxed);
+
+        if (int32_t(b - t) < 0){
+            // empty, restore the bottom
+            _bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        fn = _fns[b & _mask].load(std::memory_order_relaxed);
+        arg = _args[b & _mask].load(std::memory_order_relaxed);
+        if (b != t){
+            return true;
+        }
+
+        // last item, race against the stealers for it
+        bool won = _top.compare_exchange_strong(
+            t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed
+        );
+        _bottom.store(b + 1, std::memory_order_relaxed);
+        return won;
+    }
+
+    /**
+     * @brief Steal the oldest job, may be called by any task
+     * @return false if the deque is empty or another task won the race
+    */
+    bool steal(_JobFunction& fn, void*& arg){
+        uint32_t t = _top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint32_t b = _bottom.load(std::memory_order_acquire);
+
+        if (int32_t(b - t) <= 0){
+            return false;
+        }
+
+        fn = _fns[t & _mask].load(std::memory_order_relaxed);
+        arg = _args[t & _mask].load(std::memory_order_relaxed);
+        return _top.compare_exchange_strong(
+            t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed
+        );
+    }
+
+    /**
+     * @brief Check if the deque looks empty, might be outdated right after the call
+    */
+    bool empty() const{
+        uint32_t b = _bottom.load(std::memory_order_acquire);
+        uint32_t t = _top.load(std::memory_order_acquire);
+        return int32_t(b - t) <= 0;
+    }
+};
+
+END_TASKS_NAMESPACE
@@ -0,0 +1,75 @@
+/*
+
+ArduinoAsyncTasks - Scheduler dispatch order test
+
+Jobs due in the same tick must start earliest deadline first, with the jobs
+without a deadline (an interval of 0, or a cron schedule) last. Built with the
+tick count starting just below the wrap around (`configINITIAL_TICK_COUNT`),
+so the planned times and the deadlines of the jobs straddle it.
+
+    ./async_tasks_test_edf
+
+*/
+
+#include <ArduinoAsyncTasks.h>
+#include <Scheduler.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static std::vector<char> order;
+
+static void check(bool ok, const char* what, int& failures){
+    printf("%s  %s\n", ok ? "ok  " : "FAIL", what);
+    failures += !ok;
+}
+
+// (deadline job A, overdue) (job B without a deadline) (deadline job C, not due yet)
+// are all due when the tick runs, they must start A, C, B
+static void mixedDeadlines(int& failures){
+    Scheduler scheduler;
+    order.clear();
+    TickType_t added = xTaskGetTickCount();
+
+    // planned at `added`, deadline 10 ms later, overdue by the tick
+    scheduler.addTask([](){ order.push_back('A'); },
+        ScheduleParams(1, TimeUnit::Days, ExecutionPolicy::Inline).setDeadline(10));
+    // an interval of 0 has no deadline
+    scheduler.addTask([](){ order.push_back('B'); },
+        ScheduleParams(0, TimeUnit::Milliseconds, ExecutionPolicy::Inline).setOffset(13));
+    // planned 14 ms after `added`, deadline 100 ms later
+    scheduler.addTask([](){ order.push_back('C'); },
+        ScheduleParams(1, TimeUnit::Days, ExecutionPolicy::Inline).setOffset(14).setDeadline(100));
+
+    delay(30);
+    scheduler.execute();
+
+    TickType_t ran = xTaskGetTickCount();
+    printf("added at tick %lu, ran at tick %lu%s\n", (unsigned long)added, (unsigned long)ran,
+        ran < added ? " (across the wrap)" : "");
+    check(std::string(order.begin(), order.end()) == "ACB",
+        "overdue deadline first, no deadline last", failures);
+}
+
+// two deadline jobs, the later planned one has the earlier deadline
+static void earlierDeadlineFirst(int& failures){
+    Scheduler scheduler;
+    order.clear();
+
+    scheduler.addTask([](){ order.push_back('A'); },
+        ScheduleParams(1, TimeUnit::Days, ExecutionPolicy::Inline).setDeadline(50));
+    scheduler.addTask([](){ order.push_back('B'); },
+        ScheduleParams(1, TimeUnit::Days, ExecutionPolicy::Inline).setOffset(5).setDeadline(20));
+
+    delay(10);
+    scheduler.execute();
+    check(std::string(order.begin(), order.end()) == "BA", "earlier deadline first", failures);
+}
+
+int main(){
+    int failures = 0;
+    mixedDeadlines(failures);
+    earlierDeadlineFirst(failures);
+    return failures ? 1 : 0;
+}